@@ -0,0 +1,346 @@
+// Micro and macro benchmarks of the ingest pipeline and the widget data paths.
+// Each benchmark repeats until --min-time has passed and reports events/s,
+// ns/event and heap allocations/event, as a text table or one JSON document.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "core.hpp"
+#include "alloc_count.hpp"
+#include "snapshot.hpp"
+#include "search.hpp"
+
+struct BenchOptions {
+    std::string input = FILE_NAME;
+    std::string filter;
+    std::string output;
+    bool json = false;
+    double min_time = 0.5;
+    size_t lines = 20000;       // Input is repeated up to this many lines
+};
+
+struct BenchResult {
+    std::string name;
+    long long events;
+    double seconds;
+    double allocs;
+};
+
+static BenchOptions options;
+static std::vector<BenchResult> results;
+
+// Runs fn, which handles `events` events per call, until min_time has passed.
+// Allocations are counted on this thread only, unless fn reports its own.
+static void run(const std::string &name, long long events, const std::function<void()> &fn, std::atomic<long long>* allocs = nullptr) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+
+    fn(); // Warm up caches and lazily built state
+    if (allocs) *allocs = 0;
+
+    long long total = 0;
+    unsigned long long allocs_start = thread_alloc_count;
+    auto start = std::chrono::steady_clock::now();
+    double seconds = 0;
+    while (seconds < options.min_time) {
+        fn();
+        total += events;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    double alloc_count = allocs ? (double)*allocs : (double)(thread_alloc_count - allocs_start);
+    results.push_back({name, total, seconds, alloc_count / total});
+
+    if (!options.json) {
+        fprintf(stderr, "%-28s %14.0f events/s %12.1f ns/event %10.2f allocs/event\n",
+                name.c_str(), total / seconds, seconds * 1e9 / total, alloc_count / total);
+    }
+}
+
+static void skip(const std::string &name, const char* reason) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+    if (!options.json) fprintf(stderr, "%-28s skipped: %s\n", name.c_str(), reason);
+}
+
+static bool parse_bench_options(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--input" && has_value) options.input = argv[++i];
+        else if (arg == "--filter" && has_value) options.filter = argv[++i];
+        else if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--format" && has_value) options.json = std::string(argv[++i]) == "json";
+        else if (arg == "--min-time" && has_value) options.min_time = atof(argv[++i]);
+        else if (arg == "--lines" && has_value) options.lines = (size_t)std::max(1, atoi(argv[++i]));
+        else {
+            std::cerr << "Usage: " << argv[0] << " [options]\n"
+                      << "  --input FILE      eve.json used as the dataset (default " << FILE_NAME << ")\n"
+                      << "  --lines N         repeat the input up to N lines (default 20000)\n"
+                      << "  --filter TEXT     run only benchmarks whose name contains TEXT\n"
+                      << "  --min-time SEC    minimum run time per benchmark (default 0.5)\n"
+                      << "  --format FORMAT   text or json (default text)\n"
+                      << "  --output FILE     write the json results to FILE instead of stdout\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_bench_options(argc, argv)) return -1;
+
+    // Dataset
+    std::vector<std::string> lines;
+    {
+        FILE* file = fopen(options.input.c_str(), "r");
+        if (!file) {
+            std::cerr << "ERROR: cannot open " << options.input << std::endl;
+            return -1;
+        }
+        std::string line;
+        while (read_line(file, line)) {
+            lines.push_back(line);
+            line.clear();
+        }
+        fclose(file);
+    }
+    if (lines.empty()) {
+        std::cerr << "ERROR: " << options.input << " has no lines" << std::endl;
+        return -1;
+    }
+    for (size_t i = 0; lines.size() < options.lines; i++) lines.push_back(lines[i]);
+    long long n = (long long)lines.size();
+
+    std::vector<nlohmann::json> events;
+    for (const auto &line : lines) events.push_back(nlohmann::json::parse(line, nullptr, false));
+
+    geo_db = open_geo_db(GEO_DB_NAME, 1);
+    tag_db = open_tag_db(TAG_DIR);
+
+    if (!geo_db && !options.json) fprintf(stderr, "Geo database not found, enriching with country \"Unknown\"\n");
+
+    // Enriched alerts, the input of the aggregate stage
+    std::vector<nlohmann::json> alerts;
+    {
+        GeoCache cache;
+        for (const auto &event : events) {
+            nlohmann::json alert;
+            if (enrich_event(event, alert, cache)) alerts.push_back(alert);
+        }
+    }
+
+    // Micro: ingest
+    {
+        std::string path = options.output.empty() ? "bench_lines.tmp" : options.output + ".lines.tmp";
+        {
+            std::ofstream out(path, std::ios::binary);
+            for (const auto &line : lines) out << line;
+        }
+        FILE* file = fopen(path.c_str(), "r");
+        std::string line;
+        run("read_line", n, [&] {
+            rewind(file);
+            while (read_line(file, line)) line.clear();
+        });
+        fclose(file);
+        std::remove(path.c_str());
+    }
+
+    long long parsed_values = 0;
+    run("json_parse", n, [&] {
+        for (const auto &line : lines) {
+            nlohmann::json j = nlohmann::json::parse(line, nullptr, false);
+            parsed_values += j.size();
+        }
+    });
+
+    long long field_bytes = 0;
+    run("json_extract_fields", n, [&] {
+        for (const auto &j : events) {
+            if (!j.is_object() || !j.contains("event_type") || j["event_type"] != "alert") continue;
+            field_bytes += j.value("src_ip", "").size() + j.value("dest_ip", "").size();
+            field_bytes += j["alert"].value("signature", "").size() + j.value("timestamp", "").size();
+        }
+    });
+
+    std::vector<std::string> timestamps;
+    for (const auto &j : events) if (j.is_object() && j.contains("timestamp")) timestamps.push_back(j["timestamp"]);
+    double time_sum = 0;
+    run("parse_timestamp", (long long)timestamps.size(), [&] {
+        for (auto &timestamp : timestamps) time_sum += parse_timestamp(timestamp, true, true);
+    });
+
+    std::vector<std::string> search_keys;
+    for (const auto &alert : alerts) search_keys.push_back(alert["src_ip"].get<std::string>() + " " + alert["signature"].get<std::string>());
+    SearchTerms terms = parse_search_terms("dropbox,-masscan");
+    long long matches = 0;
+    if (!search_keys.empty()) {
+        run("pass_search", (long long)search_keys.size(), [&] {
+            for (const auto &key : search_keys) matches += pass_search(terms, key);
+        });
+    }
+
+    // Micro: enrichment
+    if (geo_db) {
+        std::vector<std::string> ips;
+        for (const auto &j : events) if (j.is_object() && j.contains("dest_ip")) ips.push_back(j["dest_ip"]);
+        run("geo_lookup_uncached", (long long)ips.size(), [&] {
+            for (const auto &ip : ips) {
+                IP2LocationRecord *record = IP2Location_get_all(geo_db->db, (char*)ip.c_str());
+                if (record) IP2Location_free_record(record);
+            }
+        });
+
+        GeoCache cache;
+        run("enrich_event_cached", n, [&] {
+            nlohmann::json alert;
+            for (const auto &event : events) enrich_event(event, alert, cache);
+        });
+    }
+    else {
+        skip("geo_lookup_uncached", "geo database not found");
+        skip("enrich_event_cached", "geo database not found");
+    }
+
+    // Micro: queue hops
+    {
+        SharedQueue<QueuedEvent> queue;
+        run("queue_push_front", n, [&] {
+            for (long long i = 0; i < n; i++) {
+                queue.push({nlohmann::json(), 0});
+                queue.front();
+            }
+        });
+
+        std::atomic<long long> hop_allocs(0);
+        run("queue_hop_threads", n, [&] {
+            std::thread producer([&] {
+                unsigned long long start = thread_alloc_count;
+                for (long long i = 0; i < n; i++) queue.push({nlohmann::json(), 0});
+                hop_allocs += thread_alloc_count - start;
+            });
+            for (long long i = 0; i < n; i++) queue.front();
+            producer.join();
+        }, &hop_allocs);
+    }
+
+    // Micro: aggregation and widget data
+    if (!alerts.empty()) {
+        run("aggregate_event", (long long)alerts.size(), [&] {
+            for (const auto &alert : alerts) aggregate_event(alert);
+        });
+
+        run("top_n_src_ip", 1, [&] {
+            std::lock_guard<std::mutex> lock(mtx);
+            top_n(src_ip_total, 10);
+        });
+        run("top_snapshot", 1, [&] { make_top_snapshot(10); });
+        run("signature_snapshot", 1, [&] { make_signature_snapshot(); });
+        // The hour with the most distinct entries is the slowest bar to hover
+        auto busiest = all_bar_hour.begin();
+        size_t busiest_entries = 0;
+        for (auto it = all_bar_hour.begin(); it != all_bar_hour.end(); ++it) {
+            const BarDetail &detail = it->second;
+            size_t entries = detail.src_count.size() + detail.dest_count.size() + detail.signature_count.size()
+                + detail.country_count.size() + detail.tag_count.size();
+            if (entries > busiest_entries) {
+                busiest = it;
+                busiest_entries = entries;
+            }
+        }
+        run("bar_snapshot_hour", 1, [&] {
+            std::lock_guard<std::mutex> lock(mtx);
+            make_bar_snapshot(busiest->second, busiest->first, true, attacks_per_hour[busiest->first]);
+        });
+        run("trend_series_copy", 1, [&] {
+            std::vector<double> x, y;
+            std::lock_guard<std::mutex> lock(mtx);
+            x.reserve(attacks_per_minute.size());
+            y.reserve(attacks_per_minute.size());
+            for (const auto &[time, count] : attacks_per_minute) {
+                x.push_back(time);
+                y.push_back((double)count);
+            }
+        });
+    }
+    else {
+        skip("aggregate_event", "no alerts in the input");
+    }
+
+    // Macro: enrich + aggregate on one thread, then the three-stage threaded pipeline
+    {
+        GeoCache cache;
+        run("pipeline_serial", n, [&] {
+            nlohmann::json alert;
+            for (const auto &line : lines) {
+                nlohmann::json j = nlohmann::json::parse(line, nullptr, false);
+                if (!j.is_discarded() && enrich_event(j, alert, cache)) aggregate_event(alert);
+            }
+        });
+
+        std::atomic<long long> pipeline_allocs(0);
+        run("pipeline_threads", n, [&] {
+            SharedQueue<QueuedEvent> parsed, enriched;
+            // An entry with QUEUE_CLEAR ends each stage
+            std::thread parser([&] {
+                unsigned long long start = thread_alloc_count;
+                for (const auto &line : lines) parsed.push({nlohmann::json::parse(line, nullptr, false), 0});
+                parsed.push({nlohmann::json(), 0, QUEUE_CLEAR});
+                pipeline_allocs += thread_alloc_count - start;
+            });
+            std::thread enricher([&] {
+                unsigned long long start = thread_alloc_count;
+                GeoCache thread_cache;
+                while (1) {
+                    QueuedEvent event = parsed.front();
+                    if (event.control == QUEUE_CLEAR) break;
+                    nlohmann::json alert;
+                    if (enrich_event(event.data, alert, thread_cache)) enriched.push({alert, 0});
+                }
+                enriched.push({nlohmann::json(), 0, QUEUE_CLEAR});
+                pipeline_allocs += thread_alloc_count - start;
+            });
+            unsigned long long start = thread_alloc_count;
+            while (1) {
+                QueuedEvent event = enriched.front();
+                if (event.control == QUEUE_CLEAR) break;
+                aggregate_event(event.data);
+            }
+            pipeline_allocs += thread_alloc_count - start;
+            parser.join();
+            enricher.join();
+        }, &pipeline_allocs);
+    }
+
+    if (options.json) {
+        nlohmann::json list = nlohmann::json::array();
+        for (const auto &result : results) {
+            list.push_back({
+                {"name", result.name},
+                {"events", result.events},
+                {"seconds", result.seconds},
+                {"events_per_sec", result.events / result.seconds},
+                {"ns_per_event", result.seconds * 1e9 / result.events},
+                {"allocs_per_event", result.allocs}
+            });
+        }
+        nlohmann::json report = {
+            {"input", options.input},
+            {"lines", n},
+            {"build_type", BENCH_BUILD_TYPE},
+            {"geo_db", (bool)geo_db},
+            {"time", (long long)std::time(0)},
+            {"benchmarks", list}
+        };
+        if (options.output.empty()) std::cout << report.dump(2) << std::endl;
+        else std::ofstream(options.output) << report.dump(2) << std::endl;
+    }
+
+    // Keep the optimizer from dropping the loops above
+    if (field_bytes + matches + parsed_values + (long long)time_sum == -1) std::cerr << "";
+    return 0;
+}
@@ -0,0 +1,242 @@
+// Offscreen frame-time benchmark: loads an eve file into the aggregates, then
+// draws each dashboard widget for --frames frames in a hidden window and reports
+// CPU time percentiles per widget, as a text table or one JSON document.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "core.hpp"
+#include "alloc_count.hpp"
+#include "widgets.hpp"
+#include "imgui.h"
+#include "imgui_impl_glfw.h"
+#include "imgui_impl_opengl3.h"
+#include "implot.h"
+#include <GLFW/glfw3.h>
+
+struct FrameBenchOptions {
+    std::string input = FILE_NAME;
+    std::string filter;
+    std::string output;
+    bool json = false;
+    int frames = 200;
+    int width = 1400, height = 900;
+};
+
+struct Scenario {
+    std::string name;
+    std::function<void()> setup;    // Called once before the first frame
+    std::function<void()> draw;
+};
+
+static FrameBenchOptions options;
+static const int WARMUP_FRAMES = 5;
+
+static double percentile(std::vector<double> values, double q) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t i = (size_t)(q * (values.size() - 1) + 0.5);
+    return values[i];
+}
+
+static bool parse_frame_options(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--input" && has_value) options.input = argv[++i];
+        else if (arg == "--filter" && has_value) options.filter = argv[++i];
+        else if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--format" && has_value) options.json = std::string(argv[++i]) == "json";
+        else if (arg == "--frames" && has_value) options.frames = std::max(1, atoi(argv[++i]));
+        else if (arg == "--width" && has_value) options.width = std::max(320, atoi(argv[++i]));
+        else if (arg == "--height" && has_value) options.height = std::max(240, atoi(argv[++i]));
+        else {
+            std::cerr << "Usage: " << argv[0] << " [options]\n"
+                      << "  --input FILE      eve.json loaded before drawing (default " << FILE_NAME << ")\n"
+                      << "  --frames N        frames measured per widget (default 200)\n"
+                      << "  --filter TEXT     run only widgets whose name contains TEXT\n"
+                      << "  --width W         window width (default 1400)\n"
+                      << "  --height H        window height (default 900)\n"
+                      << "  --format FORMAT   text or json (default text)\n"
+                      << "  --output FILE     write the json results to FILE instead of stdout\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs the file through enrich and aggregate on this thread, returns the alert count
+static long long load_dataset(const std::string &filename) {
+    FILE* file = fopen(filename.c_str(), "r");
+    if (!file) return -1;
+
+    GeoCache cache;
+    std::string line;
+    long long alerts = 0;
+    while (read_line(file, line)) {
+        nlohmann::json j = nlohmann::json::parse(line, nullptr, false);
+        line.clear();
+        nlohmann::json alert;
+        if (!j.is_discarded() && enrich_event(j, alert, cache)) {
+            aggregate_event(alert);
+            alerts++;
+        }
+    }
+    fclose(file);
+    return alerts;
+}
+
+int main(int argc, char** argv) {
+    if (!parse_frame_options(argc, argv)) return -1;
+
+    geo_db = open_geo_db(GEO_DB_NAME, 1);
+    if (!geo_db) {
+        std::cerr << "ERROR: IP2LOCATION-LITE-DB1.IPV6.BIN not found!" << std::endl;
+        return -1;
+    }
+    tag_db = open_tag_db(TAG_DIR);
+
+    auto load_start = std::chrono::steady_clock::now();
+    long long alerts = load_dataset(options.input);
+    if (alerts < 0) {
+        std::cerr << "ERROR: cannot open " << options.input << std::endl;
+        return -1;
+    }
+    double load_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+    if (!options.json) fprintf(stderr, "Loaded %lld alerts in %.2f s\n", alerts, load_seconds);
+
+    double first_time = 0, last_time = 0;
+    if (!attacks_per_minute.empty()) {
+        first_time = attacks_per_minute.begin()->first;
+        last_time = attacks_per_minute.rbegin()->first + 60;
+    }
+
+    // Hidden window, frames are drawn into its back buffer and never shown
+    if (!glfwInit()) {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(options.width, options.height, "Frame benchmark", nullptr, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImPlot::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    ImGui::StyleColorsDark();
+    ImGui_ImplGlfw_InitForOpenGL(window, false);
+    ImGui_ImplOpenGL3_Init("#version 130");
+
+    std::vector<Scenario> scenarios = {
+        {"attack_trend_live", [] {}, ShowAttackTrend},
+        {"attack_trend_hour", [&] { SetTrendRange(last_time - 3600, last_time); }, ShowAttackTrend},
+        {"attack_trend_day", [&] { SetTrendRange(last_time - 86400, last_time); }, ShowAttackTrend},
+        {"attack_trend_month", [&] { SetTrendRange(last_time - 2592000, last_time); }, ShowAttackTrend},
+        {"attack_trend_all", [&] { SetTrendRange(first_time, last_time); }, ShowAttackTrend},
+        {"top_src_ip", [] {}, ShowTopSrcIP},
+        {"top_dest_ip", [] {}, ShowTopDestIP},
+        {"top_country", [] {}, ShowTopCountry},
+        {"top_tag", [] {}, ShowTopTag},
+        {"signature_table", [] {}, ShowSignatureTable},
+        {"pipeline", [] {}, ShowPipeline},
+        {"log_table", [] { SetLogFilter(""); }, ShowLogTable},
+        {"log_table_filtered", [] { SetLogFilter("scan,-dropbox"); }, ShowLogTable}
+    };
+
+    nlohmann::json list = nlohmann::json::array();
+    for (const auto &scenario : scenarios) {
+        if (!options.filter.empty() && scenario.name.find(options.filter) == std::string::npos) continue;
+        scenario.setup();
+
+        std::vector<double> widget_ms, frame_ms;
+        unsigned long long allocs = 0;
+        int measured = 0;
+        for (int frame = 0; measured < options.frames; frame++) {
+            glfwPollEvents();
+            unsigned long long allocs_start = thread_alloc_count;
+            auto frame_start = std::chrono::steady_clock::now();
+
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+            ImGui::SetNextWindowPos(ImVec2(0, 0));
+            ImGui::SetNextWindowSize(io.DisplaySize);
+            ImGui::Begin("Dashboard", NULL, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove);
+            auto widget_start = std::chrono::steady_clock::now();
+            scenario.draw();
+            auto widget_end = std::chrono::steady_clock::now();
+            ImGui::End();
+
+            ImGui::Render();
+            int display_w, display_h;
+            glfwGetFramebufferSize(window, &display_w, &display_h);
+            glViewport(0, 0, display_w, display_h);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            auto frame_end = std::chrono::steady_clock::now();
+
+            // The trend series is rebuilt on the executor, frames are timed once it is drawn
+            if (frame < WARMUP_FRAMES || AttackTrendPending()) continue;
+            measured++;
+            widget_ms.push_back(std::chrono::duration<double, std::milli>(widget_end - widget_start).count());
+            frame_ms.push_back(std::chrono::duration<double, std::milli>(frame_end - frame_start).count());
+            allocs += thread_alloc_count - allocs_start;
+        }
+
+        double allocs_per_frame = (double)allocs / options.frames;
+        list.push_back({
+            {"name", scenario.name},
+            {"frames", options.frames},
+            {"widget_p50_ms", percentile(widget_ms, 0.50)},
+            {"widget_p99_ms", percentile(widget_ms, 0.99)},
+            {"frame_p50_ms", percentile(frame_ms, 0.50)},
+            {"frame_p99_ms", percentile(frame_ms, 0.99)},
+            {"frame_max_ms", percentile(frame_ms, 1.0)},
+            {"allocs_per_frame", allocs_per_frame}
+        });
+        if (!options.json) {
+            fprintf(stderr, "%-22s widget p50 %8.3f ms  p99 %8.3f ms | frame p50 %8.3f ms  p99 %8.3f ms | %8.1f allocs/frame\n",
+                    scenario.name.c_str(), percentile(widget_ms, 0.50), percentile(widget_ms, 0.99),
+                    percentile(frame_ms, 0.50), percentile(frame_ms, 0.99), allocs_per_frame);
+        }
+    }
+
+    if (options.json) {
+        nlohmann::json report = {
+            {"input", options.input},
+            {"alerts", alerts},
+            {"load_seconds", load_seconds},
+            {"width", options.width},
+            {"height", options.height},
+            {"build_type", BENCH_BUILD_TYPE},
+            {"time", (long long)std::time(0)},
+            {"widgets", list}
+        };
+        if (options.output.empty()) std::cout << report.dump(2) << std::endl;
+        else std::ofstream(options.output) << report.dump(2) << std::endl;
+    }
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImPlot::DestroyContext();
+    ImGui::DestroyContext();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include "core.hpp"
+#include "report.hpp"
+#include "cli.hpp"
+#include "checkpoint.hpp"
+
+// Headless collector: the pipeline threads do the work, the main thread only writes reports
+int main(int argc, char** argv) {
+    AppOptions options;
+    if (!parse_options(argc, argv, options, false)) return -1;
+    if (!options.query.empty()) return run_query_command(options);
+    if (!start_app(options)) return -1;
+
+    install_exit_handler();
+    print_data(options.report);
+    return 0;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <arpa/inet.h>
+#endif
+
+// Maps an IP address to the set of tags (up to 64) whose CIDR lists cover it.
+// IPv4 uses a DIR-24-8 table and IPv6 one hash table per prefix length,
+// so a lookup costs the same no matter how many prefixes are loaded.
+class PrefixTable {
+    private:
+        static const uint32_t TBL8_FLAG = 0x80000000u;
+
+        struct V6Key {
+            uint64_t hi, lo;
+            bool operator==(const V6Key &o) const { return hi == o.hi && lo == o.lo; }
+        };
+        struct V6Hash {
+            size_t operator()(const V6Key &k) const { return std::hash<uint64_t>()(k.hi * 31 + k.lo); }
+        };
+        using V6Map = std::unordered_map<V6Key, uint64_t, V6Hash>;
+
+        std::vector<uint32_t> tbl24;                      // set id, or TBL8_FLAG | group
+        std::vector<uint32_t> tbl8;                       // groups of 256 set ids
+        std::vector<uint64_t> sets = {0};                 // set id -> tag mask, 0 = untagged
+        std::unordered_map<uint64_t, uint32_t> set_ids = {{0, 0}};
+        std::unordered_map<uint64_t, uint32_t> with_tag_memo;
+        std::vector<std::pair<int, V6Map>> v6_lengths;    // sorted by prefix length
+        std::vector<std::string> names;
+        size_t prefixes = 0;
+
+        uint32_t with_tag(uint32_t set_id, int tag) {
+            uint64_t bit = 1ull << tag;
+            if (sets[set_id] & bit) return set_id;
+
+            uint64_t key = ((uint64_t)set_id << 6) | tag;
+            auto memo = with_tag_memo.find(key);
+            if (memo != with_tag_memo.end()) return memo->second;
+
+            uint64_t mask = sets[set_id] | bit;
+            auto found = set_ids.find(mask);
+            uint32_t id;
+            if (found != set_ids.end()) id = found->second;
+            else {
+                id = (uint32_t)sets.size();
+                sets.push_back(mask);
+                set_ids[mask] = id;
+            }
+            with_tag_memo[key] = id;
+            return id;
+        }
+
+        void insert_v4(uint32_t addr, int len, int tag) {
+            if (tbl24.empty()) tbl24.assign(1u << 24, 0);
+            addr &= len ? ~0u << (32 - len) : 0;
+
+            if (len <= 24) {
+                uint32_t first = addr >> 8;
+                uint32_t count = 1u << (24 - len);
+                for (uint32_t i = first; i < first + count; i++) {
+                    if (tbl24[i] & TBL8_FLAG) {
+                        uint32_t *group = &tbl8[(size_t)(tbl24[i] & ~TBL8_FLAG) * 256];
+                        for (int k = 0; k < 256; k++) group[k] = with_tag(group[k], tag);
+                    }
+                    else tbl24[i] = with_tag(tbl24[i], tag);
+                }
+                return;
+            }
+
+            uint32_t idx = addr >> 8;
+            if (!(tbl24[idx] & TBL8_FLAG)) {
+                uint32_t group = (uint32_t)(tbl8.size() / 256);
+                tbl8.insert(tbl8.end(), 256, tbl24[idx]);
+                tbl24[idx] = TBL8_FLAG | group;
+            }
+            uint32_t *group = &tbl8[(size_t)(tbl24[idx] & ~TBL8_FLAG) * 256];
+            uint32_t first = addr & 0xff;
+            uint32_t count = 1u << (32 - len);
+            for (uint32_t k = first; k < first + count; k++) group[k] = with_tag(group[k], tag);
+        }
+
+        static V6Key mask_v6(V6Key key, int len) {
+            if (len <= 64) {
+                key.hi &= len ? ~0ull << (64 - len) : 0;
+                key.lo = 0;
+            }
+            else key.lo &= ~0ull << (128 - len);
+            return key;
+        }
+
+        static V6Key to_v6_key(const unsigned char *bytes) {
+            V6Key key = {0, 0};
+            for (int i = 0; i < 8; i++) key.hi = (key.hi << 8) | bytes[i];
+            for (int i = 8; i < 16; i++) key.lo = (key.lo << 8) | bytes[i];
+            return key;
+        }
+
+        void insert_v6(V6Key key, int len, int tag) {
+            auto it = std::lower_bound(v6_lengths.begin(), v6_lengths.end(), len,
+                [](const std::pair<int, V6Map> &a, int l) { return a.first < l; });
+            if (it == v6_lengths.end() || it->first != len) it = v6_lengths.insert(it, {len, V6Map()});
+            it->second[mask_v6(key, len)] |= 1ull << tag;
+        }
+
+    public:
+        PrefixTable() {}
+
+        // Returns the new tag id, or -1 when all 64 tags are in use
+        int add_tag(const std::string &name) {
+            if (names.size() >= 64) return -1;
+            names.push_back(name);
+            return (int)names.size() - 1;
+        }
+
+        // Accepts "addr/len" or a bare address
+        bool insert(const std::string &cidr, int tag) {
+            size_t slash = cidr.find('/');
+            std::string addr = cidr.substr(0, slash);
+            int len = -1;
+            if (slash != std::string::npos) {
+                try { len = std::stoi(cidr.substr(slash + 1)); }
+                catch (...) { return false; }
+            }
+
+            unsigned char bytes[16];
+            if (addr.find(':') == std::string::npos) {
+                if (inet_pton(AF_INET, addr.c_str(), bytes) != 1) return false;
+                if (len == -1) len = 32;
+                if (len < 0 || len > 32) return false;
+                insert_v4(((uint32_t)bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3], len, tag);
+            }
+            else {
+                if (inet_pton(AF_INET6, addr.c_str(), bytes) != 1) return false;
+                if (len == -1) len = 128;
+                if (len < 0 || len > 128) return false;
+                insert_v6(to_v6_key(bytes), len, tag);
+            }
+            prefixes++;
+            return true;
+        }
+
+        uint64_t lookup(const std::string &ip) const {
+            unsigned char bytes[16];
+            if (ip.find(':') == std::string::npos) {
+                if (tbl24.empty() || inet_pton(AF_INET, ip.c_str(), bytes) != 1) return 0;
+                uint32_t entry = tbl24[((uint32_t)bytes[0] << 16) | (bytes[1] << 8) | bytes[2]];
+                if (entry & TBL8_FLAG) entry = tbl8[(size_t)(entry & ~TBL8_FLAG) * 256 + bytes[3]];
+                return sets[entry];
+            }
+
+            if (v6_lengths.empty() || inet_pton(AF_INET6, ip.c_str(), bytes) != 1) return 0;
+            V6Key key = to_v6_key(bytes);
+            uint64_t tags = 0;
+            for (const auto &[len, map] : v6_lengths) {
+                auto found = map.find(mask_v6(key, len));
+                if (found != map.end()) tags |= found->second;
+            }
+            return tags;
+        }
+
+        std::vector<std::string> tag_names(uint64_t tags) const {
+            std::vector<std::string> result;
+            for (size_t i = 0; i < names.size(); i++) {
+                if (tags & (1ull << i)) result.push_back(names[i]);
+            }
+            return result;
+        }
+
+        size_t size() const { return prefixes; }
+};
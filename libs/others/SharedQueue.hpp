@@ -34,4 +34,9 @@ class SharedQueue {
             std::lock_guard<std::mutex> lock(mtx);
             return q.empty();
         }
+
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return q.size();
+        }
 };
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "alloc_count.hpp"
+#include <new>
+#include <cstdlib>
+
+thread_local unsigned long long thread_alloc_count = 0;
+
+// Every replaceable form is defined, so each new pairs with a matching delete.
+// They live alone in this file, so nothing they free is inlined into callers.
+static void* count_alloc(std::size_t size) {
+    thread_alloc_count++;
+    return std::malloc(size ? size : 1);
+}
+
+static void* count_alloc_aligned(std::size_t size, std::align_val_t align) {
+    thread_alloc_count++;
+    std::size_t alignment = (std::size_t)align;
+    #ifdef _WIN32
+        return _aligned_malloc(size ? size : 1, alignment);
+    #else
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(alignment, ((size ? size : 1) + alignment - 1) / alignment * alignment);
+    #endif
+}
+
+static void free_aligned(void* p) {
+    #ifdef _WIN32
+        _aligned_free(p);
+    #else
+        std::free(p);
+    #endif
+}
+
+void* operator new(std::size_t size) {
+    if (void* p = count_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* p = count_alloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return count_alloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return count_alloc(size); }
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    if (void* p = count_alloc_aligned(size, align)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    if (void* p = count_alloc_aligned(size, align)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return count_alloc_aligned(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return count_alloc_aligned(size, align); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { free_aligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { free_aligned(p); }
@@ -0,0 +1,8 @@
+#pragma once
+
+// Counting global allocator. Only the targets that report allocations (the
+// dashboard and the benchmarks) link alloc_count.cpp, the core library and the
+// headless collector keep the default one.
+
+// Heap allocations made by the calling thread
+extern thread_local unsigned long long thread_alloc_count;
@@ -0,0 +1,521 @@
+#include "checkpoint.hpp"
+#include "core.hpp"
+#include "memory.hpp"
+#include "segment.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include <iostream>
+#include <sstream>
+#include <filesystem>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <cstdlib>
+#ifndef _WIN32
+    #include <sys/stat.h>
+#endif
+
+static const char CHECKPOINT_MAGIC[4] = {'S', 'C', 'K', 'P'};
+static const uint64_t CHECKPOINT_VERSION = 2;
+static const size_t PREFIX_BYTES = 4096;   // Fingerprint of the input, survives appends
+
+// Leaked, the exit handler thread may still use them while statics are destroyed
+static std::string &checkpoint_file = *new std::string;
+static std::string &input_file = *new std::string;
+static std::mutex &written_mtx = *new std::mutex;
+static std::condition_variable &written_cv = *new std::condition_variable;
+static unsigned long long written_count = 0;   // Guarded by written_mtx
+static std::atomic<bool> enabled(false), requested(false), exit_requested(false);
+static int interval_seconds = 60;
+static long long start_offset = 0;
+
+static uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Which file the offset belongs to: rotation gives a new inode or a different
+// first block, truncation a size below the offset
+struct InputIdentity {
+    uint64_t device = 0, inode = 0;
+    uint64_t size = 0;
+    uint64_t prefix_bytes = 0, prefix_hash = 0;
+};
+
+static bool input_identity(const std::string &filename, InputIdentity &id, size_t prefix_bytes = PREFIX_BYTES) {
+    std::error_code ec;
+    id.size = std::filesystem::file_size(filename, ec);
+    if (ec) return false;
+    #ifndef _WIN32
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0) return false;
+        id.device = (uint64_t)st.st_dev;
+        id.inode = (uint64_t)st.st_ino;
+    #endif
+
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file) return false;
+    std::string prefix(std::min<uint64_t>(id.size, prefix_bytes), '\0');
+    prefix.resize(fread(&prefix[0], 1, prefix.size(), file));
+    fclose(file);
+    id.prefix_bytes = prefix.size();
+    id.prefix_hash = fnv1a(prefix.data(), prefix.size());
+    return true;
+}
+
+// filename is still the file saved was taken from, current is read over the same prefix
+static bool same_input(const InputIdentity &saved, const std::string &filename, InputIdentity &current) {
+    return input_identity(filename, current, (size_t)saved.prefix_bytes) && current.device == saved.device && current.inode == saved.inode
+        && current.prefix_bytes == saved.prefix_bytes && current.prefix_hash == saved.prefix_hash;
+}
+
+// Encoding
+class CheckpointWriter {
+    public:
+        std::string out;
+
+        void u64(uint64_t value) {
+            while (value >= 0x80) {
+                out += (char)(value | 0x80);
+                value >>= 7;
+            }
+            out += (char)value;
+        }
+        void i64(long long value) { u64(((uint64_t)value << 1) ^ (uint64_t)(value >> 63)); }
+        void f64(double value) {
+            char bytes[8];
+            memcpy(bytes, &value, 8);
+            out.append(bytes, 8);
+        }
+        void str(const std::string &value) {
+            u64(value.size());
+            out += value;
+        }
+};
+
+// Every read past the end returns zeros and clears ok, so callers check once at the end
+class CheckpointReader {
+    private:
+        const char* pos;
+        const char* end;
+
+    public:
+        bool ok = true;
+
+        CheckpointReader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+        uint64_t u64() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (pos == end) break;
+                unsigned char byte = (unsigned char)*pos++;
+                value |= (uint64_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) return value;
+            }
+            ok = false;
+            return 0;
+        }
+        long long i64() {
+            uint64_t value = u64();
+            return (long long)(value >> 1) ^ -(long long)(value & 1);
+        }
+        double f64() {
+            double value = 0;
+            if (end - pos < 8) {
+                ok = false;
+                return 0;
+            }
+            memcpy(&value, pos, 8);
+            pos += 8;
+            return value;
+        }
+        std::string str() {
+            uint64_t size = u64();
+            if (size > (uint64_t)(end - pos)) {
+                ok = false;
+                return std::string();
+            }
+            std::string value(pos, (size_t)size);
+            pos += size;
+            return value;
+        }
+        // Element counts, bounded by the bytes left so a corrupt count can't allocate
+        size_t count() {
+            uint64_t n = u64();
+            if (n > (uint64_t)(end - pos)) {
+                ok = false;
+                return 0;
+            }
+            return (size_t)n;
+        }
+};
+
+static void write_counts(CheckpointWriter &w, const std::map<std::string, long long> &map) {
+    w.u64(map.size());
+    for (const auto &[key, count] : map) {
+        w.str(key);
+        w.i64(count);
+    }
+}
+
+// Keys were written in order, so every insert goes to the end without a search
+static void read_counts(CheckpointReader &r, std::map<std::string, long long> &map) {
+    size_t n = r.count();
+    for (size_t i = 0; i < n && r.ok; i++) {
+        std::string key = r.str();
+        map.emplace_hint(map.end(), std::move(key), r.i64());
+    }
+}
+
+static void write_times(CheckpointWriter &w, const std::map<double, long long> &map) {
+    w.u64(map.size());
+    for (const auto &[time, count] : map) {
+        w.f64(time);
+        w.i64(count);
+    }
+}
+
+static void read_times(CheckpointReader &r, std::map<double, long long> &map) {
+    size_t n = r.count();
+    for (size_t i = 0; i < n && r.ok; i++) {
+        double time = r.f64();
+        map.emplace_hint(map.end(), time, r.i64());
+    }
+}
+
+static void write_bars(CheckpointWriter &w, const std::map<double, BarDetail> &map) {
+    w.u64(map.size());
+    for (const auto &[time, bar] : map) {
+        w.f64(time);
+        for (const auto* counts : {&bar.src_count, &bar.dest_count, &bar.signature_count, &bar.country_count, &bar.tag_count}) {
+            write_counts(w, *counts);
+        }
+    }
+}
+
+static void read_bars(CheckpointReader &r, std::map<double, BarDetail> &map) {
+    size_t n = r.count();
+    for (size_t i = 0; i < n && r.ok; i++) {
+        BarDetail &bar = map.emplace_hint(map.end(), r.f64(), BarDetail())->second;
+        for (auto* counts : {&bar.src_count, &bar.dest_count, &bar.signature_count, &bar.country_count, &bar.tag_count}) {
+            read_counts(r, *counts);
+        }
+    }
+}
+
+static void write_log(CheckpointWriter &w, const LogInfo &info) {
+    w.f64(info.timestamp);
+    w.str(info.src_ip);
+    w.str(info.dest_ip);
+    w.str(info.country);
+    w.str(info.signature);
+    w.str(info.tags);
+}
+
+static LogInfo read_log(CheckpointReader &r) {
+    LogInfo info;
+    info.timestamp = r.f64();
+    info.src_ip = r.str();
+    info.dest_ip = r.str();
+    info.country = r.str();
+    info.signature = r.str();
+    info.tags = r.str();
+    return info;
+}
+
+static void write_sketch(CheckpointWriter &w, const CountMinSketch &sketch) {
+    w.u64(sketch.counters().size());
+    for (long long cell : sketch.counters()) w.i64(cell);
+    w.u64(sketch.filter_words().size());
+    for (uint64_t word : sketch.filter_words()) w.u64(word);
+}
+
+static void read_sketch(CheckpointReader &r, CountMinSketch &sketch) {
+    std::vector<long long> cells(r.count());
+    for (auto &cell : cells) cell = r.i64();
+    std::vector<uint64_t> words(r.count());
+    for (auto &word : words) word = r.u64();
+    if (!sketch.set_counters(std::move(cells), std::move(words))) r.ok = false;
+}
+
+// Checkpoints
+void checkpoint_enable(const std::string &filename, const std::string &input, int interval) {
+    checkpoint_file = filename;
+    input_file = input;
+    interval_seconds = std::max(1, interval);
+    enabled = true;
+    if (segment_store) segment_store->hold_superseded();
+}
+
+bool checkpoint_enabled() {
+    return enabled;
+}
+
+long long checkpoint_start_offset() {
+    return start_offset;
+}
+
+bool checkpoint_due() {
+    if (!enabled) return false;
+    if (requested.exchange(false)) return true;
+
+    // Only called by the reader. Nothing new read, nothing to save.
+    static auto last = std::chrono::steady_clock::now();
+    static long long last_read = events_read;
+    auto now = std::chrono::steady_clock::now();
+    if (now - last < std::chrono::seconds(interval_seconds) || events_read == last_read) return false;
+    last = now;
+    last_read = events_read;
+    return true;
+}
+
+bool write_checkpoint(long long offset) {
+    InputIdentity id;
+    if (!input_identity(input_file, id)) {
+        std::cerr << "ERROR: cannot read " << input_file << " for the checkpoint" << std::endl;
+        return false;
+    }
+
+    // Only the aggregating thread writes the aggregates, so they are read without mtx
+    uint64_t start = ticks_now();
+    CheckpointWriter w;
+    w.out.append(CHECKPOINT_MAGIC, 4);
+    w.u64(CHECKPOINT_VERSION);
+    w.u64(id.device);
+    w.u64(id.inode);
+    w.u64(id.prefix_bytes);
+    w.u64(id.prefix_hash);
+    w.i64(offset);
+
+    w.i64(sum);
+    w.u64(log_seq);
+    for (const auto* map : {&src_ip_total, &dest_ip_total, &country_total, &signature_total, &tag_total}) write_counts(w, *map);
+    write_times(w, attacks_per_hour);
+    write_times(w, attacks_per_minute);
+    write_bars(w, all_bar_hour);
+    write_bars(w, all_bar_minute);
+    w.u64(signature_info.size());
+    for (const auto &[signature, info] : signature_info) {
+        w.str(signature);
+        w.str(info.category);
+        w.i64(info.severity);
+        w.f64(info.last_seen);
+    }
+    w.u64(all_logs.size());
+    for (const auto &info : all_logs) write_log(w, info);
+
+    write_sketch(w, src_ip_cold);
+    write_sketch(w, dest_ip_cold);
+    w.i64(memory_stats[MEM_COLD_IPS].entries);
+    w.i64(evicted_minute_buckets);
+    w.i64(evicted_hour_buckets);
+    w.i64(collapsed_ips);
+
+    // The store as of this offset: segments written so far and the rows still buffered
+    std::vector<std::string> files;
+    std::vector<LogInfo> pending;
+    if (segment_store) segment_store->snapshot(files, pending);
+    w.u64(files.size());
+    for (const auto &name : files) w.str(name);
+    w.u64(pending.size());
+    for (const auto &info : pending) write_log(w, info);
+
+    uint64_t checksum = fnv1a(w.out.data(), w.out.size());
+    w.out.append((const char*)&checksum, 8);
+
+    // Renamed over the old one, so a crash mid-write keeps the previous checkpoint
+    std::string tmp = checkpoint_file + ".tmp";
+    FILE* file = fopen(tmp.c_str(), "wb");
+    bool written = file && fwrite(w.out.data(), 1, w.out.size(), file) == w.out.size();
+    if (file && fclose(file) != 0) written = false;
+    std::error_code ec;
+    if (written) std::filesystem::rename(tmp, checkpoint_file, ec);
+    if (!written || ec) {
+        std::cerr << "ERROR: cannot write checkpoint " << checkpoint_file << std::endl;
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    if (trace_enabled) trace_record("checkpoint", start, ticks_now());
+    if (segment_store) segment_store->release_superseded(files);
+
+    {
+        std::lock_guard<std::mutex> lock(written_mtx);
+        written_count++;
+    }
+    written_cv.notify_all();
+    return true;
+}
+
+bool load_checkpoint(const std::string &filename, const std::string &input) {
+    uint64_t start = ticks_now();
+    MappedFile file(filename);
+    if (!file.data()) return false;
+    if (file.size() < 12 || memcmp(file.data(), CHECKPOINT_MAGIC, 4) != 0) {
+        std::cerr << "WARNING: " << filename << " is not a checkpoint, reading " << input << " from the start" << std::endl;
+        return false;
+    }
+    uint64_t checksum;
+    memcpy(&checksum, file.data() + file.size() - 8, 8);
+    if (fnv1a(file.data(), file.size() - 8) != checksum) {
+        std::cerr << "WARNING: checkpoint " << filename << " is corrupt, reading " << input << " from the start" << std::endl;
+        return false;
+    }
+
+    CheckpointReader r(file.data() + 4, file.size() - 12);
+    if (r.u64() != CHECKPOINT_VERSION) {
+        std::cerr << "WARNING: checkpoint " << filename << " has another version, reading " << input << " from the start" << std::endl;
+        return false;
+    }
+    InputIdentity saved, current;
+    saved.device = r.u64();
+    saved.inode = r.u64();
+    saved.prefix_bytes = r.u64();
+    saved.prefix_hash = r.u64();
+    long long offset = r.i64();
+    if (!r.ok || !same_input(saved, input, current) || (long long)current.size < offset) {
+        std::cerr << "Checkpoint " << filename << " was written for another " << input << ", reading it from the start" << std::endl;
+        return false;
+    }
+
+    // The maps are rebuilt in one pass over the mapping, in key order
+    std::vector<std::string> files;
+    std::vector<LogInfo> pending;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        sum = r.i64();
+        log_seq = r.u64();
+        for (auto* map : {&src_ip_total, &dest_ip_total, &country_total, &signature_total, &tag_total}) read_counts(r, *map);
+        read_times(r, attacks_per_hour);
+        read_times(r, attacks_per_minute);
+        read_bars(r, all_bar_hour);
+        read_bars(r, all_bar_minute);
+        size_t signatures = r.count();
+        for (size_t i = 0; i < signatures && r.ok; i++) {
+            std::string signature = r.str();
+            SignatureInfo &info = signature_info.emplace_hint(signature_info.end(), std::move(signature), SignatureInfo())->second;
+            info.category = r.str();
+            info.severity = (int)r.i64();
+            info.last_seen = r.f64();
+        }
+        size_t logs = r.count();
+        for (size_t i = 0; i < logs && r.ok; i++) {
+            all_logs.push_back(read_log(r));
+            fill_log_text(all_logs.back());
+        }
+
+        read_sketch(r, src_ip_cold);
+        read_sketch(r, dest_ip_cold);
+        memory_stats[MEM_COLD_IPS].entries = r.i64();
+        evicted_minute_buckets = r.i64();
+        evicted_hour_buckets = r.i64();
+        collapsed_ips = r.i64();
+
+        files.resize(r.count());
+        for (auto &name : files) name = r.str();
+        size_t rows = r.count();
+        for (size_t i = 0; i < rows && r.ok; i++) pending.push_back(read_log(r));
+        if (r.ok) recount_memory_stats();
+    }
+    if (!r.ok) {
+        std::cerr << "WARNING: checkpoint " << filename << " is truncated, reading " << input << " from the start" << std::endl;
+        clear_aggregates();
+        evicted_minute_buckets = 0;
+        evicted_hour_buckets = 0;
+        collapsed_ips = 0;
+        return false;
+    }
+
+    // Segments written after the checkpoint hold lines that are read again from offset
+    if (segment_store) {
+        segment_store->keep_only(files);
+        segment_store->restore_pending(pending);
+    }
+    start_offset = offset;
+    signature_version++;
+    data_version++;
+    std::cerr << "Warm start from " << filename << ": " << sum << " alerts, resuming " << input << " at byte " << offset
+              << " (loaded in " << (long long)(ticks_to_ns(ticks_now() - start) / 1e6) << " ms)" << std::endl;
+    return true;
+}
+
+bool claim_store(const std::string &input, bool warm) {
+    if (!segment_store || segment_store->read_only()) return true;
+    InputIdentity current, recorded;
+    // Not there yet: nothing of it can be stored either
+    if (!input_identity(input, current)) return true;
+
+    std::istringstream in(segment_store->input());
+    bool known = (bool)(in >> recorded.device >> recorded.inode >> recorded.prefix_bytes >> recorded.prefix_hash);
+    InputIdentity reread;
+    if (known && same_input(recorded, input, reread)) {
+        // Read from the start again: what the store holds of it would be stored twice
+        if (!warm) {
+            size_t dropped = segment_store->drop_input();
+            if (dropped > 0) std::cerr << "No usable checkpoint for " << input << ", dropping its " << dropped << " stored segments" << std::endl;
+        }
+        return true;
+    }
+
+    std::vector<std::string> files;
+    std::vector<LogInfo> pending;
+    segment_store->snapshot(files, pending);
+    if (!known && !warm && !files.empty()) {
+        std::cerr << "ERROR: the store holds alerts of an unrecorded input and there is no usable checkpoint. Reading "
+                  << input << " from the start could store its alerts twice, move the .seg files away first" << std::endl;
+        return false;
+    }
+    // A new input: the files so far belong to earlier ones. A warm start vouches for them all.
+    std::ostringstream out;
+    out << current.device << " " << current.inode << " " << current.prefix_bytes << " " << current.prefix_hash;
+    if (!segment_store->set_input(out.str(), warm ? std::vector<std::string>() : files)) {
+        std::cerr << "ERROR: cannot record the input of the store" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool checkpoint_now(int ms) {
+    if (!enabled) return false;
+    std::unique_lock<std::mutex> lock(written_mtx);
+    unsigned long long target = written_count + 1;
+    requested = true;
+    // The entry waits behind whatever is queued, on timeout the last periodic checkpoint stays
+    return written_cv.wait_for(lock, std::chrono::milliseconds(ms), [&] { return written_count >= target; });
+}
+
+void install_exit_handler() {
+    signal(SIGINT, [](int) { exit_requested = true; });
+    signal(SIGTERM, [](int) { exit_requested = true; });
+
+    std::thread([] {
+        while (!exit_requested) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        checkpoint_now(10000);
+        // After the checkpoint: segments written from here on are dropped by the next warm start
+        if (segment_store) segment_store->flush();
+        std::cout.flush();
+        fflush(nullptr);
+        std::_Exit(0);
+    }).detach();
+}
+
+long long file_tell(FILE* file) {
+    #ifdef _WIN32
+        return _ftelli64(file);
+    #else
+        return (long long)ftello(file);
+    #endif
+}
+
+bool file_seek(FILE* file, long long offset) {
+    #ifdef _WIN32
+        return _fseeki64(file, offset, SEEK_SET) == 0;
+    #else
+        return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+    #endif
+}
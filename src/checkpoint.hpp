@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+// Checkpoints of the aggregates for a fast warm start. The reader queues a
+// QUEUE_CHECKPOINT entry carrying its byte offset; process_data writes the file
+// when the entry reaches it, so the aggregates hold exactly the lines before
+// that offset. On startup the file is mmapped, decoded and the reader resumes
+// from the offset if the input is still the same file.
+//
+// Layout: "SCKP", version, input identity, reader offset, then every aggregate
+// as length-prefixed varint/double/string records, and an FNV-1a checksum.
+
+// Enables checkpoints of input to filename, every interval seconds while new lines arrive
+void checkpoint_enable(const std::string &filename, const std::string &input, int interval);
+bool checkpoint_enabled();
+
+// Loads filename into the empty aggregates if it was written for input, call
+// before start_pipeline. Returns false (and leaves the aggregates empty) otherwise.
+bool load_checkpoint(const std::string &filename, const std::string &input);
+// Records input as the input segment_store is filled from, after load_checkpoint
+// returned warm. A cold start with the recorded input drops the segments written
+// for it, as they are read again. False when the store holds segments of an
+// unrecorded input and warm is false, so they could be duplicated.
+bool claim_store(const std::string &input, bool warm);
+// Byte offset read_data starts from, set by load_checkpoint
+long long checkpoint_start_offset();
+
+// Reader side: true when a checkpoint entry should be queued now
+bool checkpoint_due();
+// Aggregating thread: writes the aggregates and offset, then wakes checkpoint_now
+bool write_checkpoint(long long offset);
+
+// Asks for a checkpoint now and waits up to ms for it to be written, e.g. before exit
+bool checkpoint_now(int ms);
+// Headless: SIGINT/SIGTERM flush the segment store and write a last checkpoint, then exit
+void install_exit_handler();
+
+// 64-bit ftell/fseek, eve.json grows past 2 GB
+long long file_tell(FILE* file);
+bool file_seek(FILE* file, long long offset);
@@ -0,0 +1,109 @@
+#include "cli.hpp"
+#include "segment.hpp"
+#include "query.hpp"
+#include "checkpoint.hpp"
+#include "http.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+static void print_usage(const char* program, bool gui) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --input FILE      eve.json to read (default " << FILE_NAME << ")\n";
+    if (gui) std::cerr << "  --headless        run the pipeline without a window and print reports\n";
+    std::cerr << "  --format FORMAT   report format: text or ndjson (default text)\n"
+              << "  --output FILE     append reports to FILE instead of stdout\n"
+              << "  --interval SEC    seconds between reports (default 5)\n"
+              << "  --top N           entries per top-N list (default 10 when headless)\n"
+              << "  --metrics-port N  serve /metrics and /top on 127.0.0.1:N\n"
+              << "  --replay SPEED    pace events by their timestamps, SPEED x real time (e.g. 1, 10, 100)\n"
+              << "  --memory-budget MB evict old detail and rare IPs to keep the aggregates under MB\n"
+              << "  --store DIR       keep every alert in hourly segment files under DIR\n"
+              << "  --checkpoint FILE save the aggregates to FILE and resume from it on start\n"
+              << "                    (default DIR/checkpoint.bin with --store)\n"
+              << "  --checkpoint-interval SEC seconds between checkpoints (default 60)\n"
+              << "  --query EXPR      print the newest alerts in --store matching EXPR and exit, e.g.\n"
+              << "                    'src_ip in 10.0.0.0/8 and severity <= 2 and time > now-1h'\n"
+              << "  --limit N         matches printed by --query (default 100)\n"
+              << "  --trace FILE      record trace zones, written to FILE on SIGUSR1";
+    if (gui) std::cerr << ", F9 and exit";
+    std::cerr << "\n";
+}
+
+bool parse_options(int argc, char** argv, AppOptions &options, bool gui) {
+    options.headless = !gui;
+    int top = -1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--headless" && gui) options.headless = true;
+        else if (arg == "--input" && has_value) options.input = argv[++i];
+        else if (arg == "--format" && has_value && (std::string(argv[i + 1]) == "text" || std::string(argv[i + 1]) == "ndjson")) {
+            options.report.json = std::string(argv[++i]) == "ndjson";
+        }
+        else if (arg == "--output" && has_value) options.report.output = argv[++i];
+        else if (arg == "--interval" && has_value) options.report.interval = std::max(1, atoi(argv[++i]));
+        else if (arg == "--top" && has_value) top = std::max(0, atoi(argv[++i]));
+        else if (arg == "--metrics-port" && has_value) options.metrics_port = std::max(0, atoi(argv[++i]));
+        else if (arg == "--replay" && has_value) options.replay = std::max(0.0, atof(argv[++i]));
+        else if (arg == "--memory-budget" && has_value) options.memory_budget = std::max(0LL, atoll(argv[++i])) * 1024 * 1024;
+        else if (arg == "--store" && has_value) options.store = argv[++i];
+        else if (arg == "--checkpoint" && has_value) options.checkpoint = argv[++i];
+        else if (arg == "--checkpoint-interval" && has_value) options.checkpoint_interval = std::max(1, atoi(argv[++i]));
+        else if (arg == "--query" && has_value) options.query = argv[++i];
+        else if (arg == "--limit" && has_value) options.limit = (size_t)std::max(0, atoi(argv[++i]));
+        else if (arg == "--trace" && has_value) options.trace = argv[++i];
+        else {
+            print_usage(argv[0], gui);
+            return false;
+        }
+    }
+    options.report.top = top != -1 ? top : (options.headless ? 10 : 0);
+    // A store without a checkpoint would get every line appended again on each start
+    if (options.checkpoint.empty() && !options.store.empty()) options.checkpoint = options.store + "/checkpoint.bin";
+    return true;
+}
+
+bool start_app(const AppOptions &options) {
+    if (!options.trace.empty()) trace_start(options.trace);
+    if (options.replay > 0) replay_enable(options.replay);
+    memory_budget = options.memory_budget;
+    // Replays would store their events twice, so they only read the store
+    if (!options.store.empty()) segment_store = std::make_shared<SegmentStore>(options.store, options.replay == 0);
+    // A replay rewinds its input, so it always starts cold
+    if (!options.checkpoint.empty() && options.replay == 0) {
+        bool warm = load_checkpoint(options.checkpoint, options.input);
+        if (!claim_store(options.input, warm)) return false;
+        checkpoint_enable(options.checkpoint, options.input, options.checkpoint_interval);
+    }
+    if (!start_pipeline(options.input)) return false;
+    return options.metrics_port == 0 || start_metrics_server(options.metrics_port);
+}
+
+int run_query_command(const AppOptions &options) {
+    if (options.store.empty()) {
+        std::cerr << "ERROR: --query needs --store" << std::endl;
+        return -1;
+    }
+    // Read-only, and the checkpoint only lends signature_info to category and severity
+    segment_store = std::make_shared<SegmentStore>(options.store, false);
+    bool loaded = !options.checkpoint.empty() && load_checkpoint(options.checkpoint, options.input);
+
+    std::string error;
+    std::shared_ptr<const Query> query = compile_query(options.query, error);
+    if (!query) {
+        std::cerr << "ERROR: " << error << std::endl;
+        return -1;
+    }
+    // Without it they would silently match nothing
+    if (query->uses_signatures && !loaded) {
+        std::cerr << "ERROR: category and severity need the checkpoint of the collector's --input, none was loaded" << std::endl;
+        return -1;
+    }
+    print_logs(options.report, run_query(*query, *segment_store, options.limit));
+    return 0;
+}
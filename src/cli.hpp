@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include "core.hpp"
+#include "report.hpp"
+
+// Command line shared by the GUI and headless executables
+struct AppOptions {
+    std::string input = FILE_NAME;
+    ReportOptions report;
+    bool headless = false;
+    int metrics_port = 0;   // 0 = no metrics server
+    double replay = 0;      // Replay speed, 0 = read as fast as possible and tail
+    std::string trace;      // Chrome trace file, empty = tracing off
+    long long memory_budget = 0;   // Bytes, 0 = unlimited
+    std::string store;      // Segment store directory, empty = no history on disk
+    std::string checkpoint; // Aggregate checkpoint file, empty = cold start every time
+    int checkpoint_interval = 60;   // Seconds
+    std::string query;      // Headless: print the matches in the store and exit
+    size_t limit = 100;     // Matches printed by --query
+};
+
+// Prints usage and returns false on an unknown argument.
+// gui tells whether --headless is available and picks the default --top.
+bool parse_options(int argc, char** argv, AppOptions &options, bool gui);
+
+// Trace, replay, memory budget, store, checkpoint, pipeline and metrics server,
+// in that order. False if any of them failed to start.
+bool start_app(const AppOptions &options);
+
+// --query: runs it over --store, newest matches first, and returns the exit code
+int run_query_command(const AppOptions &options);
@@ -0,0 +1,561 @@
+#include "core.hpp"
+#include "metrics.hpp"
+#include "snapshot.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include "segment.hpp"
+#include "checkpoint.hpp"
+#include <iostream>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <filesystem>
+#include <cctype>
+
+std::shared_ptr<GeoDB> geo_db;
+std::shared_ptr<PrefixTable> tag_db;
+std::atomic<long long> geo_reload_count(0), geo_reload_us(0);
+std::atomic<long long> tag_reload_count(0), tag_reload_us(0);
+std::deque<LogInfo> all_logs;
+unsigned long long log_seq = 0; // Logs ever pushed, all_logs[0] is log number log_seq - all_logs.size()
+std::map<std::string, long long> src_ip_total, dest_ip_total, country_total, signature_total, tag_total;
+std::map<double, long long> attacks_per_hour, attacks_per_minute;
+std::map<double, BarDetail> all_bar_hour, all_bar_minute;
+std::map<std::string, SignatureInfo> signature_info;
+long long sum = 0;
+std::mutex mtx;
+std::atomic<unsigned long long> data_version(0); // Bumped on every aggregated event
+std::atomic<unsigned long long> signature_version(0);
+std::atomic<unsigned long long> view_version(0);
+std::atomic<bool> data_wake_armed(false);
+void (*data_wake)() = nullptr;
+std::atomic<long long> events_read(0), alerts_parsed(0);
+std::atomic<long long> events_dropped(0);
+std::atomic<long long> geo_cache_hits(0), geo_cache_misses(0);
+SharedQueue<QueuedEvent> read_queue, parsed_queue;
+
+void desc_sort(std::vector<sll> &vec) {
+    std::sort(vec.begin(), vec.end(), [](const sll &a, const sll &b) {
+        return a.second > b.second;
+    });
+}
+
+std::vector<sll> top_n(const std::map<std::string, long long> &total, int n) {
+    std::vector<sll> top(std::min((size_t)n, total.size()));
+    std::partial_sort_copy(total.begin(), total.end(), top.begin(), top.end(), [](const sll &a, const sll &b) {
+        return a.second > b.second;
+    });
+    return top;
+}
+
+double parse_timestamp(std::string &timestamp, bool minute, bool second) {
+    if (timestamp == "now") return clock_now();
+
+    std::tm tm = {};
+    std::time_t t;
+    std::istringstream ss(timestamp);
+    if (second) ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+    else if (minute) ss >> std::get_time(&tm, "%Y-%m-%dT%H:%M");
+    else ss >> std::get_time(&tm, "%Y-%m-%dT%H");
+    if (ss.fail()) return -1;
+    #ifdef _WIN32
+        t = (double)_mkgmtime(&tm);
+    #else
+        t = (double)timegm(&tm);
+    #endif
+    if (t == -1) return -1;
+    return (double)t;
+}
+
+const char* format_time_buf(char *buf, size_t size, double time, bool minute, bool second) {
+    std::time_t t = (std::time_t)time;
+    std::tm tm = {};
+    #ifdef _WIN32
+        gmtime_s(&tm, &t);
+    #else
+        gmtime_r(&t, &tm);
+    #endif
+    if (second) strftime(buf, size, "%H:%M:%S %d/%m/%Y", &tm);
+    else if (minute) strftime(buf, size, "%Hh%M %d/%m/%Y", &tm);
+    else strftime(buf, size, "%Hh %d/%m/%Y", &tm);
+    return buf;
+}
+
+std::string format_time(double time, bool minute, bool second) {
+    char buf[32];
+    return format_time_buf(buf, sizeof(buf), time, minute, second);
+}
+
+std::shared_ptr<GeoDB> open_geo_db(const std::string &filename, unsigned long long generation) {
+    IP2Location *db = IP2Location_open((char*)filename.c_str());
+    if (db == NULL) return nullptr;
+
+    // Reject a half-written file before it replaces the working one
+    IP2LocationRecord *record = IP2Location_get_country_long(db, (char*)"8.8.8.8");
+    if (record == NULL) {
+        IP2Location_close(db);
+        return nullptr;
+    }
+    IP2Location_free_record(record);
+
+    return std::make_shared<GeoDB>(db, generation);
+}
+
+void watch_geo_db(std::string filename) {
+    std::error_code ec;
+    auto last_write = std::filesystem::last_write_time(filename, ec);
+    bool changed = false;
+
+    while (1) {
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+
+        auto write = std::filesystem::last_write_time(filename, ec);
+        if (ec) continue;
+        if (write != last_write) {
+            // Wait until the file stops changing before reloading
+            last_write = write;
+            changed = true;
+            continue;
+        }
+        if (!changed) continue;
+        changed = false;
+
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<GeoDB> old_db = std::atomic_load(&geo_db);
+        std::shared_ptr<GeoDB> new_db = open_geo_db(filename, old_db->generation + 1);
+        if (!new_db) {
+            std::cerr << "ERROR: failed to reload " << filename << ", keeping old database" << std::endl;
+            continue;
+        }
+
+        // Readers still holding the old database finish their lookup before it is closed
+        std::atomic_store(&geo_db, new_db);
+        auto end = std::chrono::steady_clock::now();
+        geo_reload_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        geo_reload_count++;
+    }
+}
+
+std::shared_ptr<PrefixTable> open_tag_db(const std::string &dirname) {
+    auto table = std::make_shared<PrefixTable>();
+    std::error_code ec;
+    if (!std::filesystem::is_directory(dirname, ec)) return table;
+
+    std::vector<std::filesystem::path> files;
+    for (const auto &entry : std::filesystem::directory_iterator(dirname, ec)) {
+        if (entry.is_regular_file()) files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    for (const auto &path : files) {
+        int tag = table->add_tag(path.stem().string());
+        if (tag == -1) {
+            std::cerr << "ERROR: too many tag files, ignoring " << path.string() << std::endl;
+            continue;
+        }
+
+        FILE* file = fopen(path.string().c_str(), "r");
+        if (!file) continue;
+        char buffer[256];
+        while (fgets(buffer, sizeof(buffer), file) != NULL) {
+            std::string line(buffer);
+            line = line.substr(0, line.find('#'));
+            line.erase(std::remove_if(line.begin(), line.end(), ::isspace), line.end());
+            if (!line.empty() && !table->insert(line, tag)) {
+                std::cerr << "ERROR: bad prefix \"" << line << "\" in " << path.string() << std::endl;
+            }
+        }
+        fclose(file);
+    }
+    return table;
+}
+
+// Changes whenever a tag file is added, removed or rewritten
+static long long tag_dir_stamp(const std::string &dirname) {
+    std::error_code ec;
+    long long stamp = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(dirname, ec)) {
+        stamp = stamp * 31 + entry.last_write_time(ec).time_since_epoch().count() + 1;
+    }
+    return stamp;
+}
+
+void watch_tag_db(std::string dirname) {
+    long long last_stamp = tag_dir_stamp(dirname);
+    bool changed = false;
+
+    while (1) {
+        std::this_thread::sleep_for(std::chrono::seconds(5));
+
+        long long stamp = tag_dir_stamp(dirname);
+        if (stamp != last_stamp) {
+            last_stamp = stamp;
+            changed = true;
+            continue;
+        }
+        if (!changed) continue;
+        changed = false;
+
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<PrefixTable> new_db = open_tag_db(dirname);
+        std::atomic_store(&tag_db, new_db);
+        auto end = std::chrono::steady_clock::now();
+        tag_reload_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        tag_reload_count++;
+    }
+}
+
+bool read_line(FILE* file, std::string &line) {
+    // fgets splits lines longer than the buffer, and a line being written may
+    // reach EOF without its newline, so fragments are joined until one ends it
+    char buffer[5000];
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        line += buffer;
+        if (line.back() == '\n') return true;
+    }
+    return false;
+}
+
+void read_data(std::string filename, SharedQueue<QueuedEvent> &read_queue) {
+    FILE* file = nullptr;
+    StageMetrics &metrics = stage_metrics[STAGE_READ];
+
+    file = fopen(filename.c_str(), "r");
+    if (!file) {
+        std::cerr << "ERROR: eve.json not found!" << std::endl;
+        return;
+    }
+    bool replay = replay_enabled();
+    if (replay) replay_open(file);
+    else if (checkpoint_start_offset() > 0) file_seek(file, checkpoint_start_offset());
+    trace_thread_name("read");
+
+    std::string line;
+    while (1) {
+        // Everything before this offset is queued ahead of the entry, a partial line is not
+        if (checkpoint_due()) read_queue.push({nlohmann::json{{"offset", file_tell(file) - (long long)line.size()}}, 0, QUEUE_CHECKPOINT});
+
+        uint64_t start = ticks_now();
+        if (read_line(file, line)) {
+            TRACE_ZONE("read");
+            events_read++;
+            nlohmann::json j = nlohmann::json::parse(line, nullptr, false);
+            line.clear();
+            if (j.is_discarded()) events_dropped++;
+            else {
+                // Replay holds the event until the clock reaches it, that wait is idle time
+                double time = replay ? event_time(j) : -1;
+                if (time != -1) {
+                    uint64_t wait = ticks_now();
+                    bool keep = replay_wait(time);
+                    start = ticks_now();
+                    if (trace_enabled) trace_record("replay wait", wait, start);
+                    metrics.add_idle(start - wait);
+                    if (!keep) {
+                        rewind(file);
+                        read_queue.push({nlohmann::json(), 0, QUEUE_CLEAR});
+                        continue;
+                    }
+                }
+                read_queue.push({std::move(j), start});
+            }
+
+            uint64_t end = ticks_now();
+            metrics.in.fetch_add(1, std::memory_order_relaxed);
+            metrics.out.fetch_add(1, std::memory_order_relaxed);
+            metrics.add_busy(end - start);
+            metrics.service.record(end - start);
+        } 
+        else {
+            TRACE_ZONE("eof wait");
+            clearerr(file); 
+            bool rewind_file = replay ? replay_wait_rewind(1000) : false;
+            if (!replay) std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            metrics.add_idle(ticks_now() - start);
+            if (rewind_file) {
+                rewind(file);
+                line.clear();
+                read_queue.push({nlohmann::json(), 0, QUEUE_CLEAR});
+            }
+        }
+    }
+}
+
+// j[key] if it is a string, else fallback. value() throws on other types.
+static std::string string_field(const nlohmann::json &j, const char* key, const std::string &fallback) {
+    auto it = j.find(key);
+    return it != j.end() && it->is_string() ? it->get<std::string>() : fallback;
+}
+
+bool enrich_event(const nlohmann::json &j, nlohmann::json &alert, GeoCache &cache) {
+    if (string_field(j, "event_type", "") != "alert") return false;
+    // Valid JSON but not a usable alert: dropped here, aggregate_event relies on these
+    auto details = j.find("alert");
+    if (details == j.end() || !details->is_object() || !details->contains("signature") || !(*details)["signature"].is_string()
+        || event_time(j) == -1) {
+        events_dropped++;
+        return false;
+    }
+    auto severity = details->find("severity");
+
+    std::string dest_ip = string_field(j, "dest_ip", "0.0.0.0");
+    std::string country_name = "Unknown";
+
+    std::shared_ptr<GeoDB> db = std::atomic_load(&geo_db);
+    // Without a database (benchmarks on the sample) every country stays "Unknown"
+    if (db) {
+        unsigned long long flushes = geo_cache_flushes;
+        if (db->generation != cache.generation || flushes != cache.flushes || cache.countries.size() >= GEO_CACHE_ENTRIES) {
+            memory_stats[MEM_GEO_CACHE].add(-(long long)cache.countries.size(), -cache.bytes);
+            cache.countries = {};
+            cache.bytes = 0;
+            cache.generation = db->generation;
+            cache.flushes = flushes;
+        }
+
+        auto cached = cache.countries.find(dest_ip);
+        if (cached != cache.countries.end()) {
+            country_name = cached->second;
+            geo_cache_hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            geo_cache_misses.fetch_add(1, std::memory_order_relaxed);
+            IP2LocationRecord *record = IP2Location_get_all(db->db, (char*)dest_ip.c_str());
+            if (record != NULL) {
+                country_name = record->country_long;
+                if (country_name == "-") {
+                    country_name = "Unknown/Local Network";
+                }
+                IP2Location_free_record(record);
+            }
+            long long bytes = geo_cache_entry_bytes(dest_ip, country_name);
+            cache.countries.emplace(dest_ip, country_name);
+            cache.bytes += bytes;
+            memory_stats[MEM_GEO_CACHE].add(1, bytes);
+        }
+    }
+
+    std::string src_ip = string_field(j, "src_ip", "0.0.0.0");
+    std::shared_ptr<PrefixTable> tags = std::atomic_load(&tag_db);
+    uint64_t tag_mask = tags->lookup(src_ip) | tags->lookup(dest_ip);
+
+    alert = {
+        {"src_ip", src_ip},
+        {"dest_ip", dest_ip},
+        {"signature", (*details)["signature"]},
+        {"category", string_field(*details, "category", "")},
+        {"severity", severity != details->end() && severity->is_number() ? severity->get<int>() : 0},
+        {"timestamp", j["timestamp"]},
+        {"country", country_name},
+        {"tags", tags->tag_names(tag_mask)}
+    };
+    return true;
+}
+
+void parse_data(SharedQueue<QueuedEvent> &read_queue, SharedQueue<QueuedEvent> &parsed_queue) {
+    GeoCache cache;
+    StageMetrics &metrics = stage_metrics[STAGE_PARSE];
+    trace_thread_name("parse");
+    while (1) {
+        uint64_t wait = ticks_now();
+        QueuedEvent event = read_queue.front();
+        uint64_t start = ticks_now();
+        metrics.add_idle(start - wait);
+        if (event.control != QUEUE_EVENT) {
+            parsed_queue.push(std::move(event));
+            continue;
+        }
+        metrics.in.fetch_add(1, std::memory_order_relaxed);
+        TRACE_ZONE("enrich");
+
+        nlohmann::json alert;
+        if (enrich_event(event.data, alert, cache)) {
+            alerts_parsed++;
+            parsed_queue.push({alert, event.read_tick});
+            metrics.out.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint64_t end = ticks_now();
+        metrics.add_busy(end - start);
+        metrics.service.record(end - start);
+    }
+}
+
+// Only process_data calls it, so make_top_snapshot never sees a concurrent write
+void clear_aggregates() {
+    TracedLock lock(mtx);
+    all_logs.clear();
+    src_ip_total.clear();
+    dest_ip_total.clear();
+    country_total.clear();
+    signature_total.clear();
+    tag_total.clear();
+    attacks_per_hour.clear();
+    attacks_per_minute.clear();
+    all_bar_hour.clear();
+    all_bar_minute.clear();
+    signature_info.clear();
+    reset_memory_stats();
+    sum = 0;
+    signature_version++;
+    data_version++;
+}
+
+void fill_log_text(LogInfo &info) {
+    format_time_buf(info.time_text, sizeof(info.time_text), info.timestamp, true, true);
+    info.search_key = info.src_ip + " " + info.dest_ip + " " + info.country + " " + info.signature + " " + info.tags;
+    std::transform(info.search_key.begin(), info.search_key.end(), info.search_key.begin(), ::tolower);
+}
+
+void aggregate_event(const nlohmann::json &j, uint64_t read_tick) {
+    std::string timestamp = j["timestamp"];
+    double time = parse_timestamp(timestamp, true, true);
+    double time_hour = parse_timestamp(timestamp);
+    double time_minute = parse_timestamp(timestamp, true);
+    std::string src_ip = j["src_ip"];
+    std::string dest_ip = j["dest_ip"];
+    std::string country = j["country"];
+    std::string signature = j["signature"];
+    std::string category = j["category"];
+    int severity = j["severity"];
+    std::vector<std::string> tags = j["tags"];
+
+    LogInfo info;
+    info.timestamp = time;
+    info.src_ip = src_ip;
+    info.dest_ip = dest_ip;
+    info.country = country;
+    info.signature = signature;
+    for (const auto &tag : tags) {
+        if (!info.tags.empty()) info.tags += ", ";
+        info.tags += tag;
+    }
+    fill_log_text(info);
+    // Outside mtx: buffering may hand a finished hour to the store's writer thread
+    if (segment_store) segment_store->append(info);
+
+    {
+        TracedLock lock(mtx);
+        sum++;
+        count_ip(src_ip_total, src_ip_cold, src_ip, memory_stats[MEM_SRC_IP]);
+        count_ip(dest_ip_total, dest_ip_cold, dest_ip, memory_stats[MEM_DEST_IP]);
+        count_key(signature_total, signature, memory_stats[MEM_SIGNATURE]);
+        size_t signatures = signature_info.size();
+        SignatureInfo &sig_info = signature_entry(signature);
+        if (signature_info.size() != signatures || sig_info.category != category || sig_info.severity != severity) {
+            sig_info.category = category;
+            sig_info.severity = severity;
+            signature_version++;
+        }
+        if (time > sig_info.last_seen) sig_info.last_seen = time;
+        count_key(country_total, country, memory_stats[MEM_COUNTRY]);
+        count_time(attacks_per_hour, time_hour, memory_stats[MEM_PER_HOUR]);
+        count_time(attacks_per_minute, time_minute, memory_stats[MEM_PER_MINUTE]);
+
+        // Nested entries are charged to the bucket's structure
+        MemoryStat &hour_stat = memory_stats[MEM_BAR_HOUR];
+        MemoryStat &minute_stat = memory_stats[MEM_BAR_MINUTE];
+        BarDetail &bar_hour = bar_bucket(all_bar_hour, time_hour, hour_stat);
+        BarDetail &bar_minute = bar_bucket(all_bar_minute, time_minute, minute_stat);
+        count_key(bar_hour.src_count, src_ip, hour_stat);
+        count_key(bar_hour.dest_count, dest_ip, hour_stat);
+        count_key(bar_hour.signature_count, signature, hour_stat);
+        count_key(bar_hour.country_count, country, hour_stat);
+
+        count_key(bar_minute.src_count, src_ip, minute_stat);
+        count_key(bar_minute.dest_count, dest_ip, minute_stat);
+        count_key(bar_minute.signature_count, signature, minute_stat);
+        count_key(bar_minute.country_count, country, minute_stat);
+
+        for (const auto &tag : tags) {
+            count_key(tag_total, tag, memory_stats[MEM_TAG]);
+            count_key(bar_hour.tag_count, tag, hour_stat);
+            count_key(bar_minute.tag_count, tag, minute_stat);
+        }
+
+        charge_log(info, 1);
+        all_logs.push_back(std::move(info));
+        log_seq++;
+        if (all_logs.size() > 8000) {
+            charge_log(all_logs.front(), -1);
+            all_logs.pop_front();
+        }
+        if (read_tick && track_visible.load(std::memory_order_relaxed)) unseen_read_ticks.push_back(read_tick);
+        data_version++;
+    }
+}
+
+void wake_renderer() {
+    if (data_wake_armed.exchange(false) && data_wake) data_wake();
+}
+
+void process_data(SharedQueue<QueuedEvent> &parsed_queue) {
+    StageMetrics &metrics = stage_metrics[STAGE_AGGREGATE];
+    trace_thread_name("aggregate");
+    while (1) {
+        uint64_t wait = ticks_now();
+        QueuedEvent event = parsed_queue.front();
+        uint64_t start = ticks_now();
+        metrics.add_idle(start - wait);
+
+        // This thread is the only writer of the aggregates, so it can copy them without mtx
+        if (event.control == QUEUE_SNAPSHOT) {
+            TRACE_ZONE("top snapshot");
+            std::atomic_store(&top_snapshot, make_top_snapshot(top_snapshot_n));
+            continue;
+        }
+        if (event.control == QUEUE_CLEAR) {
+            TRACE_ZONE("clear aggregates");
+            clear_aggregates();
+            wake_renderer();
+            continue;
+        }
+        if (event.control == QUEUE_CHECKPOINT) {
+            write_checkpoint(event.data["offset"].get<long long>());
+            continue;
+        }
+        metrics.in.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            TRACE_ZONE("aggregate");
+            aggregate_event(event.data, event.read_tick);
+        }
+        enforce_memory_budget();
+        wake_renderer();
+
+        uint64_t end = ticks_now();
+        metrics.out.fetch_add(1, std::memory_order_relaxed);
+        metrics.add_busy(end - start);
+        metrics.service.record(end - start);
+        read_to_aggregated.record(end - event.read_tick);
+    }
+}
+
+bool start_pipeline(const std::string &input) {
+    geo_db = open_geo_db(GEO_DB_NAME, 1);
+    if (!geo_db) {
+        std::cerr << "ERROR: IP2LOCATION-LITE-DB1.IPV6.BIN not found!" << std::endl;
+        return false;
+    }
+    tag_db = open_tag_db(TAG_DIR);
+    // After a checkpoint restored the store, so only the files it kept are merged
+    if (segment_store) segment_store->compact_fragmented();
+
+    std::thread read_thread(read_data, input, std::ref(read_queue));
+    std::thread parse_thread(parse_data, std::ref(read_queue), std::ref(parsed_queue));
+    std::thread process_thread(process_data, std::ref(parsed_queue));
+    std::thread geo_thread(watch_geo_db, GEO_DB_NAME);
+    std::thread tag_thread(watch_tag_db, TAG_DIR);
+
+    read_thread.detach();
+    parse_thread.detach();
+    process_thread.detach();
+    geo_thread.detach();
+    tag_thread.detach();
+    return true;
+}
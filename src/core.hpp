@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include "json.hpp"
+#include "SharedQueue.hpp"
+#include "PrefixTable.hpp"
+extern "C" {
+    #include "IP2Location.h"
+}
+
+// Ingestion, enrichment and aggregation shared by the GUI, headless and bench targets.
+// read_data -> read_queue -> parse_data -> parsed_queue -> process_data -> aggregates (guarded by mtx)
+
+using sll = std::pair<std::string, long long>;
+
+struct LogInfo {
+    double timestamp;
+    std::string src_ip;
+    std::string dest_ip;
+    std::string country;
+    std::string signature;
+    std::string tags;
+    std::string search_key; // Lowercase "src dest country signature tags" for the log filter
+    char time_text[24];     // Formatted once at ingest for the log table
+};
+
+struct BarDetail {
+    std::map<std::string, long long> src_count;
+    std::map<std::string, long long> dest_count;
+    std::map<std::string, long long> signature_count;
+    std::map<std::string, long long> country_count;
+    std::map<std::string, long long> tag_count;
+};
+
+struct SignatureInfo {
+    std::string category;
+    int severity = 0;
+    double last_seen = 0;
+};
+
+// Geolocation database, swapped as a whole when the file on disk changes
+struct GeoDB {
+    IP2Location *db;
+    unsigned long long generation;
+
+    GeoDB(IP2Location *db, unsigned long long generation) : db(db), generation(generation) {}
+    ~GeoDB() { IP2Location_close(db); }
+};
+
+// What a queue entry asks process_data to do. Controls pass through parse_data
+// in order, so everything queued before them is aggregated first.
+enum QueueControl {
+    QUEUE_EVENT,     // Aggregate data
+    QUEUE_SNAPSHOT,  // Publish a TopSnapshot
+    QUEUE_CLEAR,     // Empty the aggregates (replay rewind)
+    QUEUE_CHECKPOINT // Write a checkpoint, data holds the reader's byte offset
+};
+
+// Queue entry, read_tick feeds the pipeline latency metrics
+struct QueuedEvent {
+    nlohmann::json data;
+    uint64_t read_tick;
+    QueueControl control = QUEUE_EVENT;
+};
+
+// Per-thread state of enrich_event: countries of recent dest IPs, emptied when the
+// database changes, at GEO_CACHE_ENTRIES or when the memory budget asks for it
+struct GeoCache {
+    std::unordered_map<std::string, std::string> countries;
+    unsigned long long generation = 0;
+    unsigned long long flushes = 0;   // geo_cache_flushes when last emptied
+    long long bytes = 0;              // Charged to MEM_GEO_CACHE
+};
+
+const size_t GEO_CACHE_ENTRIES = 1 << 16;          // Per thread, scans would grow it without bound
+const std::string FILE_NAME = "sample/eve.json"; // Change correct path
+const std::string GEO_DB_NAME = "database/IP2LOCATION-LITE-DB1.IPV6.BIN";
+const std::string TAG_DIR = "tags"; // One CIDR list per file, tag name = file name
+
+// Databases, swapped atomically by the watch threads
+extern std::shared_ptr<GeoDB> geo_db;
+extern std::shared_ptr<PrefixTable> tag_db;
+extern std::atomic<long long> geo_reload_count, geo_reload_us;
+extern std::atomic<long long> tag_reload_count, tag_reload_us;
+
+// Aggregates, guarded by mtx
+extern std::deque<LogInfo> all_logs;     // Newest 8000, a deque so dropping the oldest is O(1)
+extern unsigned long long log_seq; // Logs ever pushed, all_logs[0] is log number log_seq - all_logs.size()
+extern std::map<std::string, long long> src_ip_total, dest_ip_total, country_total, signature_total, tag_total;
+extern std::map<double, long long> attacks_per_hour, attacks_per_minute;
+extern std::map<double, BarDetail> all_bar_hour, all_bar_minute;
+extern std::map<std::string, SignatureInfo> signature_info;
+extern long long sum;
+extern std::mutex mtx;
+
+// Counters and queues, safe to read without mtx
+extern std::atomic<unsigned long long> data_version; // Bumped on every aggregated event
+extern std::atomic<unsigned long long> signature_version; // Bumped when signature_info gains or changes an entry
+// Bumped when background work publishes something to draw (search chunks, trend series)
+extern std::atomic<unsigned long long> view_version;
+// Wakes a waiting render thread: armed by it before it sleeps, the aggregating thread
+// then calls data_wake once after the next change. Set before the first arm.
+extern std::atomic<bool> data_wake_armed;
+extern void (*data_wake)();
+// Calls data_wake if armed, after bumping data_version or view_version
+void wake_renderer();
+extern std::atomic<long long> events_read, alerts_parsed;
+extern std::atomic<long long> events_dropped;                 // Lines that are not valid JSON, alerts without signature or timestamp
+extern std::atomic<long long> geo_cache_hits, geo_cache_misses;
+extern SharedQueue<QueuedEvent> read_queue, parsed_queue;
+
+void desc_sort(std::vector<sll> &vec);
+std::vector<sll> top_n(const std::map<std::string, long long> &total, int n);
+double parse_timestamp(std::string &timestamp, bool minute = false, bool second = false);
+// Formats into a caller buffer so per-frame callers don't allocate
+const char* format_time_buf(char *buf, size_t size, double time, bool minute = false, bool second = false);
+std::string format_time(double time, bool minute = false, bool second = false);
+
+std::shared_ptr<GeoDB> open_geo_db(const std::string &filename, unsigned long long generation);
+void watch_geo_db(std::string filename);
+std::shared_ptr<PrefixTable> open_tag_db(const std::string &dirname);
+void watch_tag_db(std::string dirname);
+
+// Turns one eve event into an enriched alert, false if it is not an alert. Alerts
+// without a string signature or a parseable timestamp count as events_dropped.
+bool enrich_event(const nlohmann::json &j, nlohmann::json &alert, GeoCache &cache);
+// Adds one enriched alert to the aggregates, read_tick is kept for read_to_visible
+void aggregate_event(const nlohmann::json &j, uint64_t read_tick = 0);
+// Formats time_text and builds search_key from the other fields
+void fill_log_text(LogInfo &info);
+// Empties the aggregates, only on the aggregating thread or before start_pipeline
+void clear_aggregates();
+
+// Reads up to the next newline, keeping a partial last line in line. True once line is complete.
+bool read_line(FILE* file, std::string &line);
+void read_data(std::string filename, SharedQueue<QueuedEvent> &read_queue);
+void parse_data(SharedQueue<QueuedEvent> &read_queue, SharedQueue<QueuedEvent> &parsed_queue);
+void process_data(SharedQueue<QueuedEvent> &parsed_queue);
+
+// Opens the databases and starts the pipeline threads, false if the geo database is missing
+bool start_pipeline(const std::string &input);
@@ -0,0 +1,94 @@
+#include "executor.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <thread>
+
+// Never destroyed: detached workers may still wait on the queue when main returns
+static SharedQueue<std::function<void()>> &jobs = *new SharedQueue<std::function<void()>>;
+static std::once_flag started;
+
+size_t executor_threads() {
+    // The pipeline and render threads keep the other cores
+    unsigned cores = std::thread::hardware_concurrency();
+    return std::max(2u, std::min(4u, cores / 2));
+}
+
+static void worker() {
+    trace_thread_name("query");
+    while (true) {
+        std::function<void()> job = jobs.front();
+        job();
+    }
+}
+
+void executor_run(std::function<void()> job) {
+    std::call_once(started, [] {
+        for (size_t i = 0; i < executor_threads(); i++) std::thread(worker).detach();
+    });
+    jobs.push(std::move(job));
+}
+
+SearchTask::SearchTask(std::vector<std::shared_ptr<const Segment>> segments, std::vector<LogInfo> pending,
+                       SegmentSearch search, RowMatch match, size_t limit)
+    : segments(std::move(segments)), pending(std::move(pending)), search(std::move(search)), match(std::move(match)),
+      limit(limit), logs(std::make_shared<const std::vector<LogInfo>>()) {}
+
+std::shared_ptr<SearchTask> SearchTask::submit(SegmentStore &store, SegmentSearch search, RowMatch match, size_t limit) {
+    std::vector<std::shared_ptr<const Segment>> list;
+    std::vector<LogInfo> pending;
+    store.snapshot(list, pending);
+    std::reverse(list.begin(), list.end());
+    auto task = std::make_shared<SearchTask>(std::move(list), std::move(pending), std::move(search), std::move(match), limit);
+    // One job per worker, each queues itself again after a chunk
+    size_t workers = std::min(executor_threads(), task->chunks());
+    for (size_t i = 0; i < workers; i++) executor_run([task] { work(task); });
+    return task;
+}
+
+bool SearchTask::search_chunk(size_t i) {
+    double oldest;
+    {
+        std::lock_guard<std::mutex> lock(logs_mtx);
+        oldest = threshold;
+    }
+    if (cancelled || (i > 0 && segments[i - 1]->max_time() < oldest)) return false;
+    std::vector<LogInfo> more = i == 0 ? search_rows(pending, match, oldest, DBL_MAX, limit)
+                                       : search(*segments[i - 1], limit, oldest);
+    if (!more.empty() && !cancelled) {
+        std::lock_guard<std::mutex> lock(logs_mtx);
+        auto merged = std::make_shared<std::vector<LogInfo>>();
+        merged->reserve(logs->size() + more.size());
+        std::merge(logs->begin(), logs->end(), more.begin(), more.end(), std::back_inserter(*merged),
+                   [](const LogInfo &a, const LogInfo &b) { return a.timestamp > b.timestamp; });
+        if (merged->size() > limit) merged->resize(limit);
+        if (merged->size() >= limit) threshold = merged->back().timestamp;
+        logs = std::move(merged);
+    }
+    return true;
+}
+
+void SearchTask::work(std::shared_ptr<SearchTask> task) {
+    TRACE_ZONE("search task");
+    size_t i;
+    // Skipped and cancelled chunks cost nothing and are only counted, so done() turns true quickly
+    while ((i = task->next++) < task->chunks()) {
+        bool searched = task->search_chunk(i);
+        task->finished++;
+        // Progress and partial matches show as chunks finish, also when no new data arrives
+        view_version++;
+        wake_renderer();
+        if (searched) break;
+    }
+    // Behind the jobs submitted meanwhile, e.g. a trend rebuild
+    if (task->next < task->chunks()) executor_run([task] { work(task); });
+}
+
+float SearchTask::progress() const {
+    return (float)finished / chunks();
+}
+
+std::shared_ptr<const std::vector<LogInfo>> SearchTask::results() const {
+    std::lock_guard<std::mutex> lock(logs_mtx);
+    return logs;
+}
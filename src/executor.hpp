@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "core.hpp"
+#include "segment.hpp"
+
+// Background work for the GUI, so the render thread only submits and polls.
+// A small pool of detached threads runs jobs in submission order. A store search
+// is split into one chunk for the rows not written yet and one per segment, newest
+// first. Its jobs search one chunk and queue themselves again, so a long search
+// holds up other jobs by at most a chunk per thread. After every chunk the newest
+// matches found so far are published, so the table fills in while it runs.
+// Cancelling is cooperative: workers stop at the next chunk.
+
+// Runs job on a pool thread, the threads start with the first job
+void executor_run(std::function<void()> job);
+size_t executor_threads();
+
+// Handle of a running store search
+class SearchTask {
+    private:
+        std::vector<std::shared_ptr<const Segment>> segments;   // Newest first
+        std::vector<LogInfo> pending;                           // Rows of the store not written yet
+        SegmentSearch search;
+        RowMatch match;
+        size_t limit;
+        std::atomic<size_t> next{0}, finished{0};
+        std::atomic<bool> cancelled{false};
+
+        mutable std::mutex logs_mtx;
+        // Guarded by logs_mtx. Replaced, never modified, so readers keep a snapshot without copying.
+        std::shared_ptr<const std::vector<LogInfo>> logs;   // Newest first, at most limit
+        double threshold = -1;                              // Time of the limit-th newest match
+
+        // Chunk 0 is the pending rows, chunk i the segment i - 1
+        size_t chunks() const { return segments.size() + 1; }
+        // Merges the matches of chunk i, false when it was skipped (cancelled or too old)
+        bool search_chunk(size_t i);
+        // One job: takes chunks until it searched one, then queues itself again if any is left
+        static void work(std::shared_ptr<SearchTask> task);
+
+    public:
+        SearchTask(std::vector<std::shared_ptr<const Segment>> segments, std::vector<LogInfo> pending,
+                   SegmentSearch search, RowMatch match, size_t limit);
+
+        // Searches the segments and pending rows of store on the pool, match is the same filter as search
+        static std::shared_ptr<SearchTask> submit(SegmentStore &store, SegmentSearch search, RowMatch match, size_t limit);
+
+        void cancel() { cancelled = true; }
+        bool done() const { return finished == chunks(); }
+        // Share of the chunks searched, 0 to 1
+        float progress() const;
+        // Matches found so far, newest first
+        std::shared_ptr<const std::vector<LogInfo>> results() const;
+};
@@ -0,0 +1,252 @@
+#include "http.hpp"
+#include "core.hpp"
+#include "metrics.hpp"
+#include "snapshot.hpp"
+#include "memory.hpp"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+#include <chrono>
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    typedef SOCKET socket_t;
+    #define close_socket closesocket
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <unistd.h>
+    typedef int socket_t;
+    #define INVALID_SOCKET (-1)
+    #define close_socket close
+#endif
+
+static const int TOP_LIMIT = 100; // Entries kept in the published snapshot
+
+static void write_summary(std::ostream &out, const char* name, const char* labels, const LatencyHistogram &h) {
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    const char* sep = labels[0] ? "," : "";
+    for (double q : quantiles) {
+        out << name << "{" << labels << sep << "quantile=\"" << q << "\"} " << h.percentile_ns(q) / 1e9 << "\n";
+    }
+    out << name << "_sum{" << labels << "} " << h.sum_ns() / 1e9 << "\n";
+    out << name << "_count{" << labels << "} " << h.count() << "\n";
+}
+
+static std::string metrics_text() {
+    std::ostringstream out;
+    long long hits = geo_cache_hits, misses = geo_cache_misses;
+
+    out << "# HELP suricata_events_read_total Lines read from eve.json\n"
+        << "# TYPE suricata_events_read_total counter\n"
+        << "suricata_events_read_total " << events_read << "\n"
+        << "# HELP suricata_events_dropped_total Lines dropped because they are not valid JSON or alerts without signature or timestamp\n"
+        << "# TYPE suricata_events_dropped_total counter\n"
+        << "suricata_events_dropped_total " << events_dropped << "\n"
+        << "# HELP suricata_alerts_parsed_total Alerts enriched by the parse stage\n"
+        << "# TYPE suricata_alerts_parsed_total counter\n"
+        << "suricata_alerts_parsed_total " << alerts_parsed << "\n"
+        << "# HELP suricata_alerts_aggregated_total Alerts counted in the aggregates\n"
+        << "# TYPE suricata_alerts_aggregated_total counter\n"
+        << "suricata_alerts_aggregated_total " << stage_metrics[STAGE_AGGREGATE].out << "\n";
+
+    out << "# HELP suricata_queue_depth Events waiting between stages\n"
+        << "# TYPE suricata_queue_depth gauge\n"
+        << "suricata_queue_depth{queue=\"read\"} " << read_queue.size() << "\n"
+        << "suricata_queue_depth{queue=\"parsed\"} " << parsed_queue.size() << "\n";
+
+    out << "# HELP suricata_geo_cache_lookups_total Country lookups by cache result\n"
+        << "# TYPE suricata_geo_cache_lookups_total counter\n"
+        << "suricata_geo_cache_lookups_total{result=\"hit\"} " << hits << "\n"
+        << "suricata_geo_cache_lookups_total{result=\"miss\"} " << misses << "\n"
+        << "# HELP suricata_geo_cache_hit_ratio Share of country lookups served from the cache\n"
+        << "# TYPE suricata_geo_cache_hit_ratio gauge\n"
+        << "suricata_geo_cache_hit_ratio " << (hits + misses ? (double)hits / (hits + misses) : 0.0) << "\n";
+
+    out << "# HELP suricata_db_reloads_total Hot reloads of the geo and tag databases\n"
+        << "# TYPE suricata_db_reloads_total counter\n"
+        << "suricata_db_reloads_total{db=\"geo\"} " << geo_reload_count << "\n"
+        << "suricata_db_reloads_total{db=\"tag\"} " << tag_reload_count << "\n";
+
+    out << "# HELP suricata_stage_events_total Events entering and leaving each stage (frames for render)\n"
+        << "# TYPE suricata_stage_events_total counter\n";
+    for (const auto &stage : stage_metrics) {
+        out << "suricata_stage_events_total{stage=\"" << stage.name << "\",direction=\"in\"} " << stage.in << "\n"
+            << "suricata_stage_events_total{stage=\"" << stage.name << "\",direction=\"out\"} " << stage.out << "\n";
+    }
+    out << "# HELP suricata_stage_seconds_total Time each stage spent working or waiting\n"
+        << "# TYPE suricata_stage_seconds_total counter\n";
+    for (const auto &stage : stage_metrics) {
+        out << "suricata_stage_seconds_total{stage=\"" << stage.name << "\",state=\"busy\"} " << ticks_to_ns(stage.busy_ticks) / 1e9 << "\n"
+            << "suricata_stage_seconds_total{stage=\"" << stage.name << "\",state=\"idle\"} " << ticks_to_ns(stage.idle_ticks) / 1e9 << "\n";
+    }
+    out << "# HELP suricata_stage_service_seconds Time per event in each stage, per frame for render\n"
+        << "# TYPE suricata_stage_service_seconds summary\n";
+    for (const auto &stage : stage_metrics) {
+        std::string labels = std::string("stage=\"") + stage.name + "\"";
+        write_summary(out, "suricata_stage_service_seconds", labels.c_str(), stage.service);
+    }
+
+    out << "# HELP suricata_latency_seconds End-to-end latency from reading a line\n"
+        << "# TYPE suricata_latency_seconds summary\n";
+    write_summary(out, "suricata_latency_seconds", "path=\"read_to_aggregated\"", read_to_aggregated);
+    write_summary(out, "suricata_latency_seconds", "path=\"read_to_visible\"", read_to_visible);
+
+    out << "# HELP suricata_structure_bytes Estimated heap bytes per aggregate\n"
+        << "# TYPE suricata_structure_bytes gauge\n";
+    for (const auto &stat : memory_stats) {
+        out << "suricata_structure_bytes{structure=\"" << stat.name << "\"} " << stat.bytes << "\n";
+    }
+    out << "# HELP suricata_memory_bytes Estimated heap bytes of all aggregates\n"
+        << "# TYPE suricata_memory_bytes gauge\n"
+        << "suricata_memory_bytes " << memory_total() << "\n"
+        << "# HELP suricata_memory_budget_bytes Memory budget, 0 = unlimited\n"
+        << "# TYPE suricata_memory_budget_bytes gauge\n"
+        << "suricata_memory_budget_bytes " << memory_budget << "\n"
+        << "# HELP suricata_evictions_total Entries evicted to stay within the memory budget\n"
+        << "# TYPE suricata_evictions_total counter\n"
+        << "suricata_evictions_total{kind=\"minute_bucket\"} " << evicted_minute_buckets << "\n"
+        << "suricata_evictions_total{kind=\"hour_bucket\"} " << evicted_hour_buckets << "\n"
+        << "suricata_evictions_total{kind=\"cold_ip\"} " << collapsed_ips << "\n";
+
+    std::shared_ptr<const TopSnapshot> snapshot = std::atomic_load(&top_snapshot);
+    if (snapshot) {
+        out << "# HELP suricata_structure_entries Entries per aggregate, as of the last published snapshot\n"
+            << "# TYPE suricata_structure_entries gauge\n";
+        for (const auto &[name, entries] : snapshot->entries) {
+            out << "suricata_structure_entries{structure=\"" << name << "\"} " << entries << "\n";
+        }
+    }
+    return out.str();
+}
+
+static std::string top_json(int n) {
+    const char* names[] = {"src_ip", "dest_ip", "country", "signature", "tag"};
+    std::shared_ptr<const TopSnapshot> snapshot = std::atomic_load(&top_snapshot);
+    if (!snapshot) return "{}";
+
+    nlohmann::json result = {{"time", snapshot->time}, {"alerts_aggregated", snapshot->sum}};
+    for (int i = 0; i < 5; i++) {
+        nlohmann::json list = nlohmann::json::array();
+        for (int k = 0; k < (int)snapshot->tops[i].size() && k < n; k++) {
+            list.push_back({{"name", snapshot->tops[i][k].first}, {"count", snapshot->tops[i][k].second}});
+        }
+        result[std::string("top_") + names[i]] = list;
+    }
+    return result.dump();
+}
+
+static void send_response(socket_t client, const char* status, const char* type, const std::string &body) {
+    std::ostringstream out;
+    out << "HTTP/1.1 " << status << "\r\n"
+        << "Content-Type: " << type << "\r\n"
+        << "Content-Length: " << body.size() << "\r\n"
+        << "Connection: close\r\n\r\n"
+        << body;
+    std::string response = out.str();
+    size_t sent = 0;
+    while (sent < response.size()) {
+        int n = send(client, response.data() + sent, (int)(response.size() - sent), 0);
+        if (n <= 0) break;
+        sent += n;
+    }
+}
+
+static void handle_client(socket_t client) {
+    // Only the request line matters, headers and body are ignored
+    char buffer[2048];
+    int len = recv(client, buffer, sizeof(buffer) - 1, 0);
+    if (len <= 0) return;
+    buffer[len] = '\0';
+
+    std::string request(buffer);
+    std::string path = request.substr(0, request.find('\r'));
+    if (path.compare(0, 4, "GET ") != 0) {
+        send_response(client, "405 Method Not Allowed", "text/plain", "GET only\n");
+        return;
+    }
+    path = path.substr(4, path.find(' ', 4) - 4);
+    std::string query;
+    size_t mark = path.find('?');
+    if (mark != std::string::npos) {
+        query = path.substr(mark + 1);
+        path = path.substr(0, mark);
+    }
+
+    if (path == "/metrics") {
+        send_response(client, "200 OK", "text/plain; version=0.0.4", metrics_text());
+    }
+    else if (path == "/top") {
+        int n = 10;
+        if (query.compare(0, 2, "n=") == 0) n = std::max(1, std::min(TOP_LIMIT, atoi(query.c_str() + 2)));
+        send_response(client, "200 OK", "application/json", top_json(n));
+    }
+    else {
+        send_response(client, "404 Not Found", "text/plain", "Try /metrics or /top\n");
+    }
+}
+
+// Asks process_data for a fresh TopSnapshot once a second while data changes
+static void request_snapshots() {
+    unsigned long long version = ULLONG_MAX;
+    while (1) {
+        if (version != data_version) {
+            version = data_version;
+            parsed_queue.push({nlohmann::json(), 0, QUEUE_SNAPSHOT});
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+static void serve(socket_t listener) {
+    while (1) {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) continue;
+
+        // A stalled client must not hold the server forever
+        #ifdef _WIN32
+            DWORD timeout = 2000;
+        #else
+            timeval timeout = {2, 0};
+        #endif
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        handle_client(client);
+        close_socket(client);
+    }
+}
+
+bool start_metrics_server(int port) {
+    #ifdef _WIN32
+        WSADATA wsa;
+        WSAStartup(MAKEWORD(2, 2), &wsa);
+    #endif
+
+    socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        std::cerr << "ERROR: cannot create metrics socket" << std::endl;
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0) {
+        std::cerr << "ERROR: cannot listen on 127.0.0.1:" << port << std::endl;
+        close_socket(listener);
+        return false;
+    }
+
+    top_snapshot_n = TOP_LIMIT;
+    std::thread server_thread(serve, listener);
+    std::thread snapshot_thread(request_snapshots);
+    server_thread.detach();
+    snapshot_thread.detach();
+    return true;
+}
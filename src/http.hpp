@@ -0,0 +1,8 @@
+#pragma once
+
+// Minimal HTTP listener on 127.0.0.1:port, one thread, one request per connection:
+//   /metrics  pipeline counters in Prometheus text format
+//   /top?n=N  current top-N tables as JSON
+// Reads only atomics, queue sizes and the published TopSnapshot, never mtx.
+// Returns false if the port cannot be bound.
+bool start_metrics_server(int port);
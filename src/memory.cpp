@@ -0,0 +1,307 @@
+#include "memory.hpp"
+#include "trace.hpp"
+#include "segment.hpp"
+#include <algorithm>
+#include <functional>
+
+MemoryStat memory_stats[MEM_COUNT] = {
+    MemoryStat("all_logs"), MemoryStat("src_ip_total"), MemoryStat("dest_ip_total"),
+    MemoryStat("country_total"), MemoryStat("signature_total"), MemoryStat("tag_total"),
+    MemoryStat("signature_info"), MemoryStat("attacks_per_hour"), MemoryStat("attacks_per_minute"),
+    MemoryStat("all_bar_hour"), MemoryStat("all_bar_minute"), MemoryStat("cold_ips"),
+    MemoryStat("geo_cache"), MemoryStat("store_buffers")
+};
+std::atomic<long long> memory_budget(0);
+std::atomic<long long> evicted_minute_buckets(0), evicted_hour_buckets(0), collapsed_ips(0);
+std::atomic<unsigned long long> geo_cache_flushes(0);
+CountMinSketch src_ip_cold, dest_ip_cold;
+
+// Never evicted below these, so the recent past stays fully detailed
+static const size_t KEEP_MINUTES = 60;
+static const size_t KEEP_HOURS = 24;
+static const size_t KEEP_IPS = 1000;
+static const long long BUFFER_SHARE = 8;   // The geo caches and store buffers each keep up to budget / BUFFER_SHARE
+
+// Total that has to be passed before trying again after a pass that could not get under target
+static long long retry_above = 0;
+
+// Estimates for libstdc++ on 64-bit: rb-tree node header, malloc chunk header, SSO capacity
+static const long long MAP_NODE = 32;
+static const long long MALLOC_OVERHEAD = 16;
+static const size_t SSO_CAPACITY = 15;
+
+static long long string_heap(const std::string &s) {
+    return s.size() > SSO_CAPACITY ? (long long)s.size() + 1 + MALLOC_OVERHEAD : 0;
+}
+
+template <class K, class V>
+static long long node_bytes() {
+    return MAP_NODE + (long long)sizeof(std::pair<const K, V>) + MALLOC_OVERHEAD;
+}
+
+// Nested nodes and their bytes, as charged by count_key
+static std::pair<long long, long long> bar_detail_usage(const BarDetail &bar) {
+    long long nodes = 0, bytes = 0;
+    for (const auto* map : {&bar.src_count, &bar.dest_count, &bar.signature_count, &bar.country_count, &bar.tag_count}) {
+        nodes += (long long)map->size();
+        for (const auto &[key, count] : *map) bytes += node_bytes<std::string, long long>() + string_heap(key);
+    }
+    return {nodes, bytes};
+}
+
+long long memory_total() {
+    long long total = 0;
+    for (const auto &stat : memory_stats) total += stat.bytes.load(std::memory_order_relaxed);
+    return total;
+}
+
+// CountMinSketch
+size_t CountMinSketch::cell(size_t hash, int row) {
+    // Row hashes derived from one string hash (Kirsch-Mitzenmacher)
+    size_t second = (hash * 0x9E3779B97F4A7C15ULL) | 1;
+    return (size_t)row * WIDTH + (hash + row * second) % WIDTH;
+}
+
+size_t CountMinSketch::filter_bit(size_t hash, int i) {
+    // Independent of the cell positions: seeded by the upper half of the hash
+    size_t base = hash >> 32 | hash << 32;
+    size_t step = (hash * 0xC2B2AE3D27D4EB4FULL) | 1;
+    return (base + i * step) % FILTER_BITS;
+}
+
+void CountMinSketch::add(const std::string &key, long long count) {
+    if (cells.empty()) {
+        cells.assign((size_t)DEPTH * WIDTH, 0);
+        filter.assign(FILTER_BITS / 64, 0);
+    }
+    size_t hash = std::hash<std::string>()(key);
+    for (int row = 0; row < DEPTH; row++) cells[cell(hash, row)] += count;
+    for (int i = 0; i < FILTER_HASHES; i++) {
+        size_t bit = filter_bit(hash, i);
+        filter[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool CountMinSketch::contains(const std::string &key) const {
+    if (filter.empty()) return false;
+    size_t hash = std::hash<std::string>()(key);
+    for (int i = 0; i < FILTER_HASHES; i++) {
+        size_t bit = filter_bit(hash, i);
+        if (!(filter[bit / 64] >> (bit % 64) & 1)) return false;
+    }
+    return true;
+}
+
+long long CountMinSketch::estimate(const std::string &key) const {
+    if (!contains(key)) return 0;
+    size_t hash = std::hash<std::string>()(key);
+    long long result = cells[cell(hash, 0)];
+    for (int row = 1; row < DEPTH; row++) result = std::min(result, cells[cell(hash, row)]);
+    return result;
+}
+
+void CountMinSketch::clear() {
+    cells.clear();
+    cells.shrink_to_fit();
+    filter.clear();
+    filter.shrink_to_fit();
+}
+
+bool CountMinSketch::set_counters(std::vector<long long> counters, std::vector<uint64_t> words) {
+    if (!counters.empty() && counters.size() != (size_t)DEPTH * WIDTH) return false;
+    if (!words.empty() && words.size() != FILTER_BITS / 64) return false;
+    if (counters.empty() != words.empty()) return false;
+    cells = std::move(counters);
+    filter = std::move(words);
+    return true;
+}
+
+// Accounting helpers
+void count_key(std::map<std::string, long long> &map, const std::string &key, MemoryStat &stat) {
+    auto [it, inserted] = map.try_emplace(key, 0);
+    it->second++;
+    if (inserted) stat.add(1, node_bytes<std::string, long long>() + string_heap(key));
+}
+
+void count_ip(std::map<std::string, long long> &map, CountMinSketch &cold, const std::string &ip, MemoryStat &stat) {
+    auto [it, inserted] = map.try_emplace(ip, 0);
+    if (inserted) {
+        stat.add(1, node_bytes<std::string, long long>() + string_heap(ip));
+        if (cold.contains(ip) && memory_stats[MEM_COLD_IPS].entries > 0) memory_stats[MEM_COLD_IPS].add(-1, 0);
+    }
+    it->second++;
+}
+
+std::vector<sll> top_ips(const std::map<std::string, long long> &map, const CountMinSketch &cold, int n) {
+    if (cold.counters().empty()) return top_n(map, n);
+    std::vector<sll> counts;
+    counts.reserve(map.size());
+    for (const auto &[ip, count] : map) counts.push_back({ip, count + cold.estimate(ip)});
+    size_t top = std::min((size_t)std::max(n, 0), counts.size());
+    std::partial_sort(counts.begin(), counts.begin() + top, counts.end(), [](const sll &a, const sll &b) {
+        return a.second > b.second;
+    });
+    counts.resize(top);
+    return counts;
+}
+
+void count_time(std::map<double, long long> &map, double time, MemoryStat &stat) {
+    auto [it, inserted] = map.try_emplace(time, 0);
+    it->second++;
+    if (inserted) stat.add(1, node_bytes<double, long long>());
+}
+
+BarDetail &bar_bucket(std::map<double, BarDetail> &map, double time, MemoryStat &stat) {
+    auto [it, inserted] = map.try_emplace(time);
+    if (inserted) stat.add(1, node_bytes<double, BarDetail>());
+    return it->second;
+}
+
+SignatureInfo &signature_entry(const std::string &signature) {
+    auto [it, inserted] = signature_info.try_emplace(signature);
+    if (inserted) memory_stats[MEM_SIGNATURE_INFO].add(1, node_bytes<std::string, SignatureInfo>() + string_heap(signature));
+    return it->second;
+}
+
+long long log_bytes(const LogInfo &info) {
+    return (long long)sizeof(LogInfo) + string_heap(info.src_ip) + string_heap(info.dest_ip) + string_heap(info.country)
+         + string_heap(info.signature) + string_heap(info.tags) + string_heap(info.search_key);
+}
+
+void charge_log(const LogInfo &info, int sign) {
+    memory_stats[MEM_LOGS].add(sign, sign * log_bytes(info));
+}
+
+long long geo_cache_entry_bytes(const std::string &ip, const std::string &country) {
+    // Hash node (next pointer, cached hash) plus its bucket pointer
+    return 2 * (long long)sizeof(void*) + (long long)sizeof(size_t) + (long long)sizeof(std::pair<const std::string, std::string>)
+         + MALLOC_OVERHEAD + string_heap(ip) + string_heap(country);
+}
+
+void reset_memory_stats() {
+    for (int i = 0; i < MEM_AGGREGATES; i++) {
+        memory_stats[i].entries = 0;
+        memory_stats[i].bytes = 0;
+    }
+    src_ip_cold.clear();
+    dest_ip_cold.clear();
+    retry_above = 0;
+}
+
+template <class V>
+static void recount_keys(const std::map<std::string, V> &map, MemoryStat &stat) {
+    for (const auto &[key, value] : map) stat.add(1, node_bytes<std::string, V>() + string_heap(key));
+}
+
+static void recount_buckets(const std::map<double, BarDetail> &map, MemoryStat &stat) {
+    for (const auto &[time, bar] : map) {
+        auto [nodes, bytes] = bar_detail_usage(bar);
+        stat.add(1 + nodes, node_bytes<double, BarDetail>() + bytes);
+    }
+}
+
+void recount_memory_stats() {
+    long long cold_entries = memory_stats[MEM_COLD_IPS].entries;
+    for (int i = 0; i < MEM_AGGREGATES; i++) {
+        memory_stats[i].entries = 0;
+        memory_stats[i].bytes = 0;
+    }
+    for (const auto &info : all_logs) charge_log(info, 1);
+    recount_keys(src_ip_total, memory_stats[MEM_SRC_IP]);
+    recount_keys(dest_ip_total, memory_stats[MEM_DEST_IP]);
+    recount_keys(country_total, memory_stats[MEM_COUNTRY]);
+    recount_keys(signature_total, memory_stats[MEM_SIGNATURE]);
+    recount_keys(tag_total, memory_stats[MEM_TAG]);
+    recount_keys(signature_info, memory_stats[MEM_SIGNATURE_INFO]);
+    memory_stats[MEM_PER_HOUR].add((long long)attacks_per_hour.size(), (long long)attacks_per_hour.size() * node_bytes<double, long long>());
+    memory_stats[MEM_PER_MINUTE].add((long long)attacks_per_minute.size(), (long long)attacks_per_minute.size() * node_bytes<double, long long>());
+    recount_buckets(all_bar_hour, memory_stats[MEM_BAR_HOUR]);
+    recount_buckets(all_bar_minute, memory_stats[MEM_BAR_MINUTE]);
+    memory_stats[MEM_COLD_IPS].add(cold_entries, src_ip_cold.bytes() + dest_ip_cold.bytes());
+}
+
+// Budget
+static void evict_oldest(std::map<double, BarDetail> &map, MemoryStat &stat) {
+    auto oldest = map.begin();
+    auto [nodes, bytes] = bar_detail_usage(oldest->second);
+    stat.add(-(1 + nodes), -(node_bytes<double, BarDetail>() + bytes));
+    map.erase(oldest);
+}
+
+// Moves IPs seen at most threshold times into cold, returns how many moved
+static long long collapse_ips(std::map<std::string, long long> &map, CountMinSketch &cold, long long threshold, MemoryStat &stat) {
+    long long moved = 0, bytes = 0;
+    for (auto it = map.begin(); it != map.end();) {
+        if (it->second > threshold) {
+            ++it;
+            continue;
+        }
+        cold.add(it->first, it->second);
+        bytes += node_bytes<std::string, long long>() + string_heap(it->first);
+        moved++;
+        it = map.erase(it);
+    }
+    stat.add(-moved, -bytes);
+    return moved;
+}
+
+bool enforce_memory_budget() {
+    long long budget = memory_budget.load(std::memory_order_relaxed);
+    if (budget <= 0 || memory_total() <= std::max(budget, retry_above)) return false;
+
+    TRACE_ZONE("enforce memory budget");
+    long long target = budget / 10 * 9;
+
+    // Buffers over their share are freed by their own threads: counted as gone, the
+    // aggregates make up the rest. Below it they stay, emptying them every pass would
+    // only cost cache hits and fragment the store's hours.
+    long long geo_bytes = memory_stats[MEM_GEO_CACHE].bytes, store_bytes = memory_stats[MEM_STORE_BUFFERS].bytes;
+    if (geo_bytes > budget / BUFFER_SHARE) {
+        geo_cache_flushes++;
+        target += geo_bytes;
+    }
+    if (segment_store && store_bytes > budget / BUFFER_SHARE) {
+        segment_store->write_open_hours();
+        target += store_bytes;
+    }
+    TracedLock lock(mtx);
+
+    // Oldest fine-grained detail first, the trend keeps the per-minute counts
+    while (memory_total() > target && all_bar_minute.size() > KEEP_MINUTES) {
+        evict_oldest(all_bar_minute, memory_stats[MEM_BAR_MINUTE]);
+        evicted_minute_buckets++;
+    }
+    while (memory_total() > target && all_bar_hour.size() > KEEP_HOURS) {
+        evict_oldest(all_bar_hour, memory_stats[MEM_BAR_HOUR]);
+        evicted_hour_buckets++;
+    }
+
+    // Then the long tail of rarely seen IPs, raising the cut until enough is freed
+    for (long long threshold = 1; memory_total() > target && src_ip_total.size() + dest_ip_total.size() > KEEP_IPS; threshold *= 2) {
+        long long cold_bytes = src_ip_cold.bytes() + dest_ip_cold.bytes();
+        long long moved = collapse_ips(src_ip_total, src_ip_cold, threshold, memory_stats[MEM_SRC_IP])
+                        + collapse_ips(dest_ip_total, dest_ip_cold, threshold, memory_stats[MEM_DEST_IP]);
+        memory_stats[MEM_COLD_IPS].add(moved, src_ip_cold.bytes() + dest_ip_cold.bytes() - cold_bytes);
+        collapsed_ips += moved;
+    }
+
+    long long total = memory_total();
+    retry_above = total > target ? total + budget / 10 : 0;
+    data_version++;
+    return true;
+}
+
+nlohmann::json memory_json() {
+    nlohmann::json structures = nlohmann::json::object();
+    for (const auto &stat : memory_stats) {
+        structures[stat.name] = {{"entries", stat.entries.load()}, {"bytes", stat.bytes.load()}};
+    }
+    return {
+        {"total_bytes", memory_total()},
+        {"budget_bytes", memory_budget.load()},
+        {"evicted_minute_buckets", evicted_minute_buckets.load()},
+        {"evicted_hour_buckets", evicted_hour_buckets.load()},
+        {"collapsed_ips", collapsed_ips.load()},
+        {"structures", structures}
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include "core.hpp"
+#include "json.hpp"
+
+// Memory accounting of the aggregates. aggregate_event charges every entry it
+// creates and the budget charges back what it evicts, so each structure carries a
+// running estimate of its heap bytes (node, key and malloc overhead) that can be
+// read at any time without mtx. Entries are map nodes, nested ones included.
+// The geo caches of the parse threads and the rows buffered by the segment store
+// are charged by their owners; they are not aggregates and survive a clear.
+
+enum MemoryStructure {
+    MEM_LOGS, MEM_SRC_IP, MEM_DEST_IP, MEM_COUNTRY, MEM_SIGNATURE, MEM_TAG, MEM_SIGNATURE_INFO,
+    MEM_PER_HOUR, MEM_PER_MINUTE, MEM_BAR_HOUR, MEM_BAR_MINUTE, MEM_COLD_IPS,
+    MEM_GEO_CACHE, MEM_STORE_BUFFERS, MEM_COUNT
+};
+// The aggregates are the structures before this one
+const int MEM_AGGREGATES = MEM_GEO_CACHE;
+
+struct MemoryStat {
+    const char* name;
+    std::atomic<long long> entries{0}, bytes{0};
+
+    explicit MemoryStat(const char* name) : name(name) {}
+
+    void add(long long n, long long b) {
+        entries.fetch_add(n, std::memory_order_relaxed);
+        bytes.fetch_add(b, std::memory_order_relaxed);
+    }
+};
+
+extern MemoryStat memory_stats[MEM_COUNT];
+extern std::atomic<long long> memory_budget;     // Bytes, 0 = unlimited
+extern std::atomic<long long> evicted_minute_buckets, evicted_hour_buckets, collapsed_ips;
+// Bumped by the budget, every GeoCache empties itself at its next lookup
+extern std::atomic<unsigned long long> geo_cache_flushes;
+
+long long memory_total();
+
+// Count-min sketch: per-key counts in DEPTH rows of WIDTH cells. Counts are only
+// ever added, so an estimate is never below the true count. A Bloom filter of the
+// keys added tells which keys have a count at all, so keys never added don't pick
+// up the counts of others they collide with. Both are allocated on the first add.
+class CountMinSketch {
+    private:
+        static const int DEPTH = 4;
+        static const int WIDTH = 1 << 14;
+        static const int FILTER_HASHES = 4;
+        static const size_t FILTER_BITS = 1 << 21;
+        std::vector<long long> cells;
+        std::vector<uint64_t> filter;
+
+        static size_t cell(size_t hash, int row);
+        static size_t filter_bit(size_t hash, int i);
+
+    public:
+        void add(const std::string &key, long long count);
+        // False for keys never added, up to the filter's false positives
+        bool contains(const std::string &key) const;
+        // Estimate of key, 0 if it was never added
+        long long estimate(const std::string &key) const;
+        void clear();
+        long long bytes() const { return (long long)(cells.capacity() * sizeof(long long) + filter.capacity() * sizeof(uint64_t)); }
+
+        // Raw cells and filter words for checkpoints. set_counters rejects sizes other
+        // than 0 or DEPTH * WIDTH and FILTER_BITS / 64, or only one of them empty.
+        const std::vector<long long> &counters() const { return cells; }
+        const std::vector<uint64_t> &filter_words() const { return filter; }
+        bool set_counters(std::vector<long long> counters, std::vector<uint64_t> words);
+};
+
+// Counts of IPs collapsed out of src_ip_total and dest_ip_total, guarded by mtx
+extern CountMinSketch src_ip_cold, dest_ip_cold;
+
+// Used by aggregate_event, caller holds mtx
+// ++map[key], a new entry is charged to stat
+void count_key(std::map<std::string, long long> &map, const std::string &key, MemoryStat &stat);
+// Same for an IP map. A collapsed IP that shows up again starts over at 0 and
+// keeps its count in cold, top_ips adds the two.
+void count_ip(std::map<std::string, long long> &map, CountMinSketch &cold, const std::string &ip, MemoryStat &stat);
+void count_time(std::map<double, long long> &map, double time, MemoryStat &stat);
+BarDetail &bar_bucket(std::map<double, BarDetail> &map, double time, MemoryStat &stat);
+SignatureInfo &signature_entry(const std::string &signature);
+// sign is 1 when a log is pushed, -1 when it is dropped
+void charge_log(const LogInfo &info, int sign);
+// Heap bytes of one log, as charged by charge_log
+long long log_bytes(const LogInfo &info);
+// Heap bytes of one GeoCache entry
+long long geo_cache_entry_bytes(const std::string &ip, const std::string &country);
+// Top n IPs of map by their count plus what was collapsed into cold, caller holds mtx
+std::vector<sll> top_ips(const std::map<std::string, long long> &map, const CountMinSketch &cold, int n);
+// After the aggregates were emptied
+void reset_memory_stats();
+// Recomputes every stat by walking the aggregates, after loading a checkpoint. Caller holds mtx.
+void recount_memory_stats();
+
+// Evicts down to 90% of memory_budget: the geo caches and the segment store's open
+// hours first when over an eighth of the budget (emptied and written by their
+// threads), then the oldest minute details,
+// the oldest hour details, then IPs seen at most 1, 2, 4... times into src_ip_cold/dest_ip_cold.
+// Only the aggregating thread may call it, takes mtx itself. True if anything was evicted.
+bool enforce_memory_budget();
+
+// Entries and bytes per structure for reports
+nlohmann::json memory_json();
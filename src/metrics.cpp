@@ -0,0 +1,124 @@
+#include "metrics.hpp"
+#include "core.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+StageMetrics stage_metrics[STAGE_COUNT] = {
+    StageMetrics("read"), StageMetrics("parse"), StageMetrics("aggregate"), StageMetrics("render")
+};
+LatencyHistogram read_to_aggregated, read_to_visible;
+std::atomic<bool> track_visible(false);
+std::vector<uint64_t> unseen_read_ticks;
+
+static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t ticks_now() {
+    #if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+    #else
+        return steady_ns();
+    #endif
+}
+
+// Ticks and ns at startup, the ratio to now gives the tick rate
+static const uint64_t start_ticks = ticks_now();
+static const uint64_t start_ns = steady_ns();
+
+double ticks_to_ns(uint64_t ticks) {
+    #if defined(__x86_64__) || defined(__i386__)
+        uint64_t elapsed_ticks = ticks_now() - start_ticks;
+        uint64_t elapsed_ns = steady_ns() - start_ns;
+        if (elapsed_ticks == 0 || elapsed_ns < 1000000) return (double)ticks;
+        return ticks * ((double)elapsed_ns / elapsed_ticks);
+    #else
+        return (double)ticks;
+    #endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto &c : counts) c.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::index(uint64_t v) {
+    if (v < (uint64_t)SUB) return (int)v;
+    int magnitude = 63 - __builtin_clzll(v);
+    int shift = magnitude - SUB_BITS;
+    return (shift + 1) * SUB + (int)((v >> shift) - SUB);
+}
+
+uint64_t LatencyHistogram::highest_equivalent(int idx) {
+    if (idx < SUB) return idx;
+    int shift = idx / SUB - 1;
+    uint64_t sub = idx % SUB + SUB;
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ticks) {
+    counts[index(ticks)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum_ticks.fetch_add(ticks, std::memory_order_relaxed);
+    uint64_t current = max_value.load(std::memory_order_relaxed);
+    while (ticks > current && !max_value.compare_exchange_weak(current, ticks, std::memory_order_relaxed)) {}
+}
+
+double LatencyHistogram::percentile_ns(double q) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t target = (uint64_t)(q * n);
+    if (target >= n) target = n - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen > target) return ticks_to_ns(std::min(highest_equivalent(i), max_value.load(std::memory_order_relaxed)));
+    }
+    return max_ns();
+}
+
+void mark_frame_visible() {
+    static std::vector<uint64_t> ticks;
+    {
+        TracedLock lock(mtx);
+        ticks.swap(unseen_read_ticks);
+    }
+    uint64_t now = ticks_now();
+    for (uint64_t t : ticks) read_to_visible.record(now - t);
+    ticks.clear();
+}
+
+static nlohmann::json latency_json(const LatencyHistogram &h) {
+    return {
+        {"count", h.count()},
+        {"p50_us", h.percentile_ns(0.50) / 1000}, {"p90_us", h.percentile_ns(0.90) / 1000},
+        {"p99_us", h.percentile_ns(0.99) / 1000}, {"p999_us", h.percentile_ns(0.999) / 1000},
+        {"max_us", h.max_ns() / 1000}
+    };
+}
+
+nlohmann::json pipeline_metrics_json() {
+    nlohmann::json stages = nlohmann::json::array();
+    for (const auto &stage : stage_metrics) {
+        uint64_t busy = stage.busy_ticks.load(std::memory_order_relaxed);
+        uint64_t idle = stage.idle_ticks.load(std::memory_order_relaxed);
+        stages.push_back({
+            {"stage", stage.name},
+            {"in", stage.in.load(std::memory_order_relaxed)},
+            {"out", stage.out.load(std::memory_order_relaxed)},
+            {"busy_ratio", busy + idle ? (double)busy / (busy + idle) : 0.0},
+            {"service", latency_json(stage.service)}
+        });
+    }
+    return {
+        {"stages", stages},
+        {"read_queue", read_queue.size()},
+        {"parsed_queue", parsed_queue.size()},
+        {"read_to_aggregated", latency_json(read_to_aggregated)},
+        {"read_to_visible", latency_json(read_to_visible)}
+    };
+}
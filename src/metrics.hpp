@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "json.hpp"
+
+// Cheap timestamp for hot paths: rdtsc on x86, steady_clock elsewhere.
+// Convert differences with ticks_to_ns, which is calibrated lazily.
+uint64_t ticks_now();
+double ticks_to_ns(uint64_t ticks);
+
+// HDR-style latency histogram: 32 linear sub-buckets per power of two, so every
+// recorded value is kept within ~3% relative error. Lock-free, values in ticks.
+class LatencyHistogram {
+    private:
+        static const int SUB_BITS = 5;
+        static const int SUB = 1 << SUB_BITS;
+        static const int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+        std::atomic<uint64_t> counts[BUCKETS];
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max_value{0};
+        std::atomic<uint64_t> sum_ticks{0};
+
+        static int index(uint64_t v);
+        static uint64_t highest_equivalent(int idx);
+
+    public:
+        LatencyHistogram();
+
+        void record(uint64_t ticks);
+        uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        // Value (ns) at or below which fraction q of the recorded values fall
+        double percentile_ns(double q) const;
+        double max_ns() const { return ticks_to_ns(max_value.load(std::memory_order_relaxed)); }
+        double sum_ns() const { return ticks_to_ns(sum_ticks.load(std::memory_order_relaxed)); }
+};
+
+// Counters of one pipeline stage. Each stage runs on a single thread, so these
+// are per-thread counters: relaxed stores by the owner, relaxed loads by readers.
+struct StageMetrics {
+    const char* name;
+    std::atomic<uint64_t> in{0}, out{0};
+    std::atomic<uint64_t> busy_ticks{0}, idle_ticks{0};
+    LatencyHistogram service;   // Time spent per event (per frame for render)
+
+    explicit StageMetrics(const char* name) : name(name) {}
+
+    void add_busy(uint64_t ticks) { busy_ticks.fetch_add(ticks, std::memory_order_relaxed); }
+    void add_idle(uint64_t ticks) { idle_ticks.fetch_add(ticks, std::memory_order_relaxed); }
+};
+
+enum Stage { STAGE_READ, STAGE_PARSE, STAGE_AGGREGATE, STAGE_RENDER, STAGE_COUNT };
+
+extern StageMetrics stage_metrics[STAGE_COUNT];
+extern LatencyHistogram read_to_aggregated;   // Line read -> counted in the aggregates
+extern LatencyHistogram read_to_visible;      // Line read -> first frame drawn with it
+extern std::atomic<bool> track_visible;       // Set by the GUI, otherwise read ticks aren't kept
+
+// Read ticks of events aggregated since the last drawn frame, guarded by mtx
+extern std::vector<uint64_t> unseen_read_ticks;
+
+// Records read_to_visible for everything aggregated so far, called by the GUI once per frame
+void mark_frame_visible();
+
+// Snapshot of all stages, queues and latencies for reports and the Pipeline tab
+nlohmann::json pipeline_metrics_json();
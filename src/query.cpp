@@ -0,0 +1,627 @@
+#include "query.hpp"
+#include "search.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <arpa/inet.h>
+#endif
+
+static const struct {
+    const char* name;
+    QueryField field;
+} QUERY_FIELDS[] = {
+    {"src_ip", Q_SRC_IP}, {"src", Q_SRC_IP}, {"dest_ip", Q_DEST_IP}, {"dest", Q_DEST_IP}, {"dst", Q_DEST_IP},
+    {"country", Q_COUNTRY}, {"signature", Q_SIGNATURE}, {"sig", Q_SIGNATURE}, {"tags", Q_TAGS}, {"tag", Q_TAGS},
+    {"category", Q_CATEGORY}, {"severity", Q_SEVERITY}, {"time", Q_TIME}
+};
+
+static std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+static bool find_field(const std::string &name, QueryField &field) {
+    for (const auto &entry : QUERY_FIELDS) {
+        if (name != entry.name) continue;
+        field = entry.field;
+        return true;
+    }
+    return false;
+}
+
+static bool is_ip_field(QueryField field) {
+    return field == Q_SRC_IP || field == Q_DEST_IP;
+}
+
+// Category and severity live in signature_info, so they are decided per signature
+static bool is_signature_field(QueryField field) {
+    return field == Q_CATEGORY || field == Q_SEVERITY;
+}
+
+// CIDRs
+static bool parse_ip(const std::string &text, bool &v6, unsigned char addr[16]) {
+    memset(addr, 0, 16);
+    v6 = text.find(':') != std::string::npos;
+    return inet_pton(v6 ? AF_INET6 : AF_INET, text.c_str(), addr) == 1;
+}
+
+static bool parse_cidr(const std::string &text, Cidr &cidr) {
+    size_t slash = text.find('/');
+    if (!parse_ip(text.substr(0, slash), cidr.v6, cidr.addr)) return false;
+    int max_bits = cidr.v6 ? 128 : 32;
+    cidr.bits = max_bits;
+    if (slash == std::string::npos) return true;
+    char* end = nullptr;
+    long bits = strtol(text.c_str() + slash + 1, &end, 10);
+    if (*end || end == text.c_str() + slash + 1 || bits < 0 || bits > max_bits) return false;
+    cidr.bits = (int)bits;
+    return true;
+}
+
+static bool cidr_contains(const Cidr &cidr, const std::string &ip) {
+    bool v6;
+    unsigned char addr[16];
+    if (!parse_ip(ip, v6, addr) || v6 != cidr.v6) return false;
+    int full = cidr.bits / 8, rest = cidr.bits % 8;
+    if (memcmp(addr, cidr.addr, full) != 0) return false;
+    if (rest == 0) return true;
+    unsigned char mask = (unsigned char)(0xff << (8 - rest));
+    return (addr[full] & mask) == (cidr.addr[full] & mask);
+}
+
+// Leaf semantics, shared by rows and dictionary strings
+static bool string_matches(const QueryNode &node, const std::string &value) {
+    SearchField field = node.field == Q_TAGS ? FIELD_TAG : FIELD_COUNTRY;   // Tags match per tag, the rest whole
+    bool found = false;
+    if (node.op == Q_CONTAINS) found = contains(lower(value), node.values[0]);
+    else {
+        for (const auto &v : node.values) found = found || field_matches(field, value, v);
+        for (const auto &cidr : node.cidrs) found = found || cidr_contains(cidr, value);
+    }
+    return node.op == Q_NE ? !found : found;
+}
+
+static bool number_matches(const QueryNode &node, double value) {
+    double n = node.numbers[0];
+    switch (node.op) {
+        case Q_EQ: return value == n;
+        case Q_NE: return value != n;
+        case Q_LT: return value < n;
+        case Q_LE: return value <= n;
+        case Q_GT: return value > n;
+        case Q_GE: return value >= n;
+        case Q_IN: return std::find(node.numbers.begin(), node.numbers.end(), value) != node.numbers.end();
+        default: return false;
+    }
+}
+
+// Lexer
+struct Token {
+    enum Type { WORD, STRING, OP, LPAREN, RPAREN, COMMA, END } type;
+    std::string text;
+    size_t pos;
+};
+
+static bool is_word_char(char c) {
+    return !isspace((unsigned char)c) && !strchr("\"'(),=!<>", c);
+}
+
+static bool tokenize(const std::string &text, std::vector<Token> &tokens, std::string &error) {
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        if (c == '(') tokens.push_back({Token::LPAREN, "(", i++});
+        else if (c == ')') tokens.push_back({Token::RPAREN, ")", i++});
+        else if (c == ',') tokens.push_back({Token::COMMA, ",", i++});
+        else if (c == '"' || c == '\'') {
+            size_t end = text.find(c, i + 1);
+            if (end == std::string::npos) {
+                error = "unterminated string at " + std::to_string(start + 1);
+                return false;
+            }
+            tokens.push_back({Token::STRING, text.substr(i + 1, end - i - 1), start});
+            i = end + 1;
+        }
+        else if (strchr("=!<>", c)) {
+            std::string op(1, c);
+            if (i + 1 < text.size() && text[i + 1] == '=') op += '=';
+            if (op == "!") {
+                error = "expected != at " + std::to_string(start + 1);
+                return false;
+            }
+            tokens.push_back({Token::OP, op, start});
+            i += op.size();
+        }
+        else {
+            while (i < text.size() && is_word_char(text[i])) i++;
+            tokens.push_back({Token::WORD, text.substr(start, i - start), start});
+        }
+    }
+    tokens.push_back({Token::END, "", text.size()});
+    return true;
+}
+
+// Seconds for "now", "now-15m", epoch seconds or an ISO date/time, -1 if none of them
+static double parse_time_value(const std::string &text, double now) {
+    if (text.compare(0, 3, "now") == 0) {
+        if (text.size() == 3) return now;
+        char* end = nullptr;
+        double amount = strtod(text.c_str() + 4, &end);
+        if ((text[3] != '-' && text[3] != '+') || end == text.c_str() + 4) return -1;
+        double unit = 0;
+        if (!strcmp(end, "s")) unit = 1;
+        else if (!strcmp(end, "m")) unit = 60;
+        else if (!strcmp(end, "h")) unit = 3600;
+        else if (!strcmp(end, "d")) unit = 86400;
+        else return -1;
+        return text[3] == '-' ? now - amount * unit : now + amount * unit;
+    }
+    char* end = nullptr;
+    double epoch = strtod(text.c_str(), &end);
+    if (!*end && end != text.c_str()) return epoch;
+
+    std::string iso = text;
+    std::replace(iso.begin(), iso.end(), ' ', 'T');
+    if (iso.size() == 10) iso += "T00:00:00";
+    else if (iso.size() == 16) iso += ":00";
+    return parse_timestamp(iso, true, true);
+}
+
+// Parser: or binds weakest, then and, then not
+class QueryParser {
+    private:
+        std::vector<Token> tokens;
+        size_t pos = 0;
+
+        const Token &peek() const { return tokens[pos]; }
+
+        bool keyword(const char* word) {
+            if (peek().type != Token::WORD || lower(peek().text) != word) return false;
+            pos++;
+            return true;
+        }
+
+        bool fail(const std::string &message) {
+            if (error.empty()) error = message + (peek().type == Token::END ? " at the end" : " at '" + peek().text + "'");
+            return false;
+        }
+
+        bool parse_value(const QueryNode &node, QueryNode &out) {
+            const Token &token = peek();
+            if (token.type != Token::WORD && token.type != Token::STRING) return fail("expected a value");
+            pos++;
+            if (node.field == Q_TIME) {
+                if (token.text.compare(0, 3, "now") == 0) relative = true;
+                double time = parse_time_value(token.text, now);
+                if (time < 0) {
+                    pos--;
+                    return fail("expected a time (now-1h, epoch seconds or 2026-10-19T09:00:00)");
+                }
+                out.numbers.push_back(time);
+            }
+            else if (node.field == Q_SEVERITY) {
+                char* end = nullptr;
+                double number = strtod(token.text.c_str(), &end);
+                if (*end || end == token.text.c_str()) {
+                    pos--;
+                    return fail("expected a number");
+                }
+                out.numbers.push_back(number);
+            }
+            else if (is_ip_field(node.field) && token.text.find('/') != std::string::npos) {
+                Cidr cidr;
+                if (!parse_cidr(token.text, cidr)) {
+                    pos--;
+                    return fail("expected a CIDR");
+                }
+                out.cidrs.push_back(cidr);
+            }
+            else out.values.push_back(lower(token.text));
+            return true;
+        }
+
+        bool parse_compare(QueryNode &node) {
+            if (peek().type != Token::WORD) return fail("expected a field");
+            if (!find_field(lower(peek().text), node.field)) return fail("unknown field");
+            pos++;
+
+            bool numeric = node.field == Q_TIME || node.field == Q_SEVERITY;
+            const Token &op = peek();
+            if (op.type == Token::OP) {
+                if (op.text == "=" || op.text == "==") node.op = Q_EQ;
+                else if (op.text == "!=") node.op = Q_NE;
+                else if (!numeric) return fail("expected =, !=, in or contains");
+                else if (op.text == "<") node.op = Q_LT;
+                else if (op.text == "<=") node.op = Q_LE;
+                else if (op.text == ">") node.op = Q_GT;
+                else node.op = Q_GE;
+                pos++;
+                return parse_value(node, node);
+            }
+            if (keyword("contains")) {
+                if (numeric) {
+                    pos--;
+                    return fail("contains needs a text field");
+                }
+                node.op = Q_CONTAINS;
+                if (peek().type != Token::WORD && peek().type != Token::STRING) return fail("expected a value");
+                node.values.push_back(lower(peek().text));
+                pos++;
+                return true;
+            }
+            if (keyword("in")) {
+                if (node.field == Q_TIME) {
+                    pos--;
+                    return fail("in needs a field other than time");
+                }
+                node.op = Q_IN;
+                if (peek().type != Token::LPAREN) return parse_value(node, node);
+                pos++;
+                while (1) {
+                    if (!parse_value(node, node)) return false;
+                    if (peek().type != Token::COMMA) break;
+                    pos++;
+                }
+                if (peek().type != Token::RPAREN) return fail("expected )");
+                pos++;
+                return true;
+            }
+            return fail("expected an operator");
+        }
+
+        bool parse_unary(QueryNode &node) {
+            if (keyword("not")) {
+                node.kind = QueryNode::NOT;
+                node.children.emplace_back();
+                return parse_unary(node.children.back());
+            }
+            if (peek().type == Token::LPAREN) {
+                pos++;
+                if (!parse_or(node)) return false;
+                if (peek().type != Token::RPAREN) return fail("expected )");
+                pos++;
+                return true;
+            }
+            return parse_compare(node);
+        }
+
+        bool parse_and(QueryNode &node) {
+            if (!parse_unary(node)) return false;
+            while (keyword("and")) {
+                if (node.kind != QueryNode::AND) {
+                    QueryNode first = std::move(node);
+                    node = QueryNode();
+                    node.kind = QueryNode::AND;
+                    node.children.push_back(std::move(first));
+                }
+                node.children.emplace_back();
+                if (!parse_unary(node.children.back())) return false;
+            }
+            return true;
+        }
+
+        bool parse_or(QueryNode &node) {
+            if (!parse_and(node)) return false;
+            while (keyword("or")) {
+                if (node.kind != QueryNode::OR) {
+                    QueryNode first = std::move(node);
+                    node = QueryNode();
+                    node.kind = QueryNode::OR;
+                    node.children.push_back(std::move(first));
+                }
+                node.children.emplace_back();
+                if (!parse_and(node.children.back())) return false;
+            }
+            return true;
+        }
+
+    public:
+        std::string error;
+        double now;              // The one clock_now for every relative time
+        bool relative = false;   // A time used now
+
+        QueryParser(std::vector<Token> tokens, double now) : tokens(std::move(tokens)), now(now) {}
+
+        bool parse(QueryNode &root) {
+            if (!parse_or(root)) return false;
+            return peek().type == Token::END || fail("expected and, or or the end");
+        }
+};
+
+// Category and severity become the set of signatures that pass
+static void resolve_signatures(QueryNode &node, const std::map<std::string, SignatureInfo> &info) {
+    for (auto &child : node.children) resolve_signatures(child, info);
+    if (node.kind != QueryNode::COMPARE || !is_signature_field(node.field)) return;
+    for (const auto &[signature, entry] : info) {
+        if (node.field == Q_SEVERITY ? number_matches(node, entry.severity) : string_matches(node, entry.category)) node.signatures.insert(signature);
+    }
+}
+
+static bool uses_signatures(const QueryNode &node) {
+    if (node.kind == QueryNode::COMPARE) return is_signature_field(node.field);
+    return std::any_of(node.children.begin(), node.children.end(), uses_signatures);
+}
+
+// Time comparisons directly under the root bound every match, segments outside are skipped
+static void time_range(const QueryNode &node, double &from, double &to) {
+    if (node.kind == QueryNode::AND) {
+        for (const auto &child : node.children) time_range(child, from, to);
+        return;
+    }
+    if (node.kind != QueryNode::COMPARE || node.field != Q_TIME) return;
+    double n = node.numbers[0];
+    if (node.op == Q_EQ || node.op == Q_GT || node.op == Q_GE) from = std::max(from, n);
+    if (node.op == Q_EQ || node.op == Q_LT || node.op == Q_LE) to = std::min(to, n);
+}
+
+bool looks_like_query(const char* text) {
+    std::string s = text;
+    s.erase(0, s.find_first_not_of(' '));
+    if (s.empty() || s[0] == '-') return false;
+
+    // A comma outside quotes and parentheses is the substring filter's separator
+    bool op = false;
+    int depth = 0;
+    char quote = 0;
+    for (char c : s) {
+        if (quote) {
+            if (c == quote) quote = 0;
+            continue;
+        }
+        if (c == '"' || c == '\'') quote = c;
+        else if (c == '(') depth++;
+        else if (c == ')') depth--;
+        else if (c == ',' && depth <= 0) return false;
+        if (strchr("=<>!()\"'", c)) op = true;
+    }
+    if (op) return true;
+
+    // "country in x" or "sig contains x" without any operator character
+    std::vector<Token> tokens;
+    std::string error;
+    QueryField field;
+    return tokenize(s, tokens, error) && tokens.size() >= 3 && find_field(lower(tokens[0].text), field)
+        && (lower(tokens[1].text) == "in" || lower(tokens[1].text) == "contains");
+}
+
+std::shared_ptr<const Query> compile_query(const std::string &text, std::string &error) {
+    std::vector<Token> tokens;
+    if (!tokenize(text, tokens, error)) return nullptr;
+    QueryParser parser(std::move(tokens), clock_now());
+    auto query = std::make_shared<Query>();
+    if (!parser.parse(query->root)) {
+        error = parser.error;
+        return nullptr;
+    }
+    if (parser.relative) query->now = parser.now;
+    query->uses_signatures = uses_signatures(query->root);
+    if (query->uses_signatures) {
+        TracedLock lock(mtx);
+        // Under mtx, so no change to signature_info slips between the two
+        query->signature_version = signature_version;
+        resolve_signatures(query->root, signature_info);
+    }
+    time_range(query->root, query->from, query->to);
+    return query;
+}
+
+bool query_outdated(const Query &query, double max_age) {
+    if (query.uses_signatures && query.signature_version != signature_version) return true;
+    return query.now >= 0 && clock_now() - query.now >= max_age;
+}
+
+// Rows
+static bool eval_row(const QueryNode &node, const LogInfo &info) {
+    switch (node.kind) {
+        case QueryNode::AND:
+            for (const auto &child : node.children) {
+                if (!eval_row(child, info)) return false;
+            }
+            return true;
+        case QueryNode::OR:
+            for (const auto &child : node.children) {
+                if (eval_row(child, info)) return true;
+            }
+            return false;
+        case QueryNode::NOT:
+            return !eval_row(node.children[0], info);
+        default:
+            break;
+    }
+    switch (node.field) {
+        case Q_SRC_IP: return string_matches(node, info.src_ip);
+        case Q_DEST_IP: return string_matches(node, info.dest_ip);
+        case Q_COUNTRY: return string_matches(node, info.country);
+        case Q_SIGNATURE: return string_matches(node, info.signature);
+        case Q_TAGS: return string_matches(node, info.tags);
+        case Q_TIME: return number_matches(node, info.timestamp);
+        default: return node.signatures.count(info.signature) > 0;
+    }
+}
+
+bool query_matches(const Query &query, const LogInfo &info) {
+    return eval_row(query.root, info);
+}
+
+// Segments: every node maps an ascending selection vector to the subset that passes
+class SegmentRun {
+    private:
+        const Segment &segment;
+        std::vector<double> times;
+
+        struct Mask {
+            std::vector<char> codes;
+            std::vector<uint32_t> matched;
+            size_t rows = 0;   // Upper bound of the rows holding a matched code
+        };
+        std::map<const QueryNode*, Mask> masks;
+
+        static SegmentColumn column(const QueryNode &node) {
+            return is_signature_field(node.field) ? SEG_SIGNATURE : (SegmentColumn)node.field;
+        }
+
+        // The comparison decided once per dictionary string
+        const Mask &mask(const QueryNode &node) {
+            auto it = masks.find(&node);
+            if (it != masks.end()) return it->second;
+            Mask &m = masks[&node];
+            SegmentColumn c = column(node);
+            m.codes.assign(segment.dictionary_size(c), 0);
+
+            if (node.op == Q_CONTAINS && !is_signature_field(node.field)) {
+                for (uint32_t code : segment.substring_codes(c, node.values[0])) m.codes[code] = 1;
+            }
+            else if (is_ip_field(node.field) && node.cidrs.empty() && (node.op == Q_EQ || node.op == Q_NE || node.op == Q_IN)) {
+                // IPs are stored lowercase, the sorted dictionary finds them
+                for (const auto &value : node.values) {
+                    long long code = segment.find(c, value);
+                    if (code >= 0) m.codes[code] = 1;
+                }
+                if (node.op == Q_NE) {
+                    for (auto &flag : m.codes) flag = !flag;
+                }
+            }
+            else {
+                for (uint32_t code = 0; code < m.codes.size(); code++) {
+                    std::string value = segment.dictionary_value(c, code);
+                    m.codes[code] = is_signature_field(node.field) ? node.signatures.count(value) > 0 : string_matches(node, value);
+                }
+            }
+            for (uint32_t code = 0; code < m.codes.size(); code++) {
+                if (!m.codes[code]) continue;
+                m.matched.push_back(code);
+                m.rows += segment.posting_size(c, code);
+            }
+            return m;
+        }
+
+        // Whether a time comparison holds for all (1), none (0) or some (-1) rows
+        int time_decided(const QueryNode &node) const {
+            bool low = number_matches(node, segment.min_time()), high = number_matches(node, segment.max_time());
+            if (node.op == Q_LT || node.op == Q_LE || node.op == Q_GT || node.op == Q_GE) return low == high ? low : -1;
+            if (node.op == Q_EQ && (node.numbers[0] < segment.min_time() || node.numbers[0] > segment.max_time())) return 0;
+            return -1;
+        }
+
+        // Rows expected to pass, orders the children of an and
+        size_t estimate(const QueryNode &node) {
+            if (node.kind != QueryNode::COMPARE) return segment.rows();
+            if (node.field != Q_TIME) return std::min<size_t>(mask(node).rows, segment.rows());
+            int decided = time_decided(node);
+            return decided == -1 ? segment.rows() / 2 : decided * segment.rows();
+        }
+
+        std::vector<uint32_t> compare(const QueryNode &node, const std::vector<uint32_t> &sel) {
+            std::vector<uint32_t> out;
+            if (node.field == Q_TIME) {
+                int decided = time_decided(node);
+                if (decided != -1) return decided ? sel : out;
+                if (times.empty()) times = segment.times();
+                for (uint32_t row : sel) {
+                    if (number_matches(node, times[row])) out.push_back(row);
+                }
+                return out;
+            }
+
+            const Mask &m = mask(node);
+            SegmentColumn c = column(node);
+            if (m.rows * 8 < sel.size()) {
+                // Index: a row has one code per column, so the postings are disjoint
+                for (uint32_t code : m.matched) {
+                    std::vector<uint32_t> rows = segment.postings(c, code);
+                    out.insert(out.end(), rows.begin(), rows.end());
+                }
+                std::sort(out.begin(), out.end());
+                if (sel.size() == segment.rows()) return out;
+                out.erase(std::remove_if(out.begin(), out.end(), [&](uint32_t row) {
+                    return !std::binary_search(sel.begin(), sel.end(), row);
+                }), out.end());
+                return out;
+            }
+            // Scan: one table lookup per selected row
+            out.reserve(sel.size());
+            for (uint32_t row : sel) {
+                if (m.codes[segment.code(c, row)]) out.push_back(row);
+            }
+            return out;
+        }
+
+    public:
+        explicit SegmentRun(const Segment &segment) : segment(segment) {}
+
+        std::vector<uint32_t> filter(const QueryNode &node, const std::vector<uint32_t> &sel) {
+            if (sel.empty()) return sel;
+            std::vector<uint32_t> out;
+            switch (node.kind) {
+                case QueryNode::AND: {
+                    std::vector<std::pair<size_t, const QueryNode*>> order;
+                    for (const auto &child : node.children) order.push_back({estimate(child), &child});
+                    std::stable_sort(order.begin(), order.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+                    out = sel;
+                    for (const auto &[rows, child] : order) {
+                        out = filter(*child, out);
+                        if (out.empty()) break;
+                    }
+                    return out;
+                }
+                case QueryNode::OR: {
+                    for (const auto &child : node.children) {
+                        std::vector<uint32_t> rows = filter(child, sel), both;
+                        std::set_union(out.begin(), out.end(), rows.begin(), rows.end(), std::back_inserter(both));
+                        out.swap(both);
+                        if (out.size() == sel.size()) break;
+                    }
+                    return out;
+                }
+                case QueryNode::NOT: {
+                    std::vector<uint32_t> rows = filter(node.children[0], sel);
+                    std::set_difference(sel.begin(), sel.end(), rows.begin(), rows.end(), std::back_inserter(out));
+                    return out;
+                }
+                default:
+                    return compare(node, sel);
+            }
+        }
+};
+
+std::vector<uint32_t> query_segment(const Query &query, const Segment &segment) {
+    std::vector<uint32_t> all(segment.rows());
+    for (uint32_t row = 0; row < all.size(); row++) all[row] = row;
+    SegmentRun run(segment);
+    return run.filter(query.root, all);
+}
+
+std::vector<LogInfo> query_segment_logs(const Query &query, const Segment &segment, size_t limit, double threshold) {
+    std::vector<LogInfo> result;
+    if (limit == 0 || segment.max_time() < query.from || segment.min_time() > query.to || segment.max_time() < threshold) return result;
+    std::vector<uint32_t> rows = query_segment(query, segment);
+    if (rows.empty()) return result;
+    std::vector<double> times = segment.times();
+    // Only the newest limit rows can make it into the result
+    std::stable_sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) { return times[a] > times[b]; });
+    if (rows.size() > limit) rows.resize(limit);
+    for (uint32_t row : rows) {
+        if (times[row] < threshold) break;
+        result.push_back(segment.log(row, times[row]));
+    }
+    return result;
+}
+
+std::vector<LogInfo> run_query(const Query &query, SegmentStore &store, size_t limit) {
+    TRACE_ZONE("run query");
+    return store.search([&](const Segment &segment, size_t limit, double threshold) {
+        return query_segment_logs(query, segment, limit, threshold);
+    }, [&](const LogInfo &info) { return query_matches(query, info); }, limit);
+}
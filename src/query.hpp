@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "core.hpp"
+#include "segment.hpp"
+
+// Structured filter for the log table and headless --query, e.g.
+//   src_ip in 10.0.0.0/8 and severity <= 2 and country != "Unknown" and time > now-1h
+//
+// Fields: src_ip (src), dest_ip (dest, dst), country, signature (sig), tags (tag),
+//         category, severity, time
+// Operators: = != < <= > >= (severity and time), in (a list, or CIDRs for IPs),
+//            contains, and / or / not, parentheses
+// Strings compare case-insensitively, tags hold when one tag of the list does.
+// Times: now, now-15m (s, m, h, d), epoch seconds or "2026-10-19T09:00:00".
+//
+// A query compiles to an AST that is run over a segment as a batch: every node
+// narrows a selection vector of row ids. A field comparison is decided once per
+// dictionary string, then either scans the selection through the code column or
+// fetches its rows from the postings, whichever touches fewer rows. The children
+// of an and run most selective first.
+
+enum QueryField { Q_SRC_IP, Q_DEST_IP, Q_COUNTRY, Q_SIGNATURE, Q_TAGS, Q_CATEGORY, Q_SEVERITY, Q_TIME };
+enum QueryOp { Q_EQ, Q_NE, Q_LT, Q_LE, Q_GT, Q_GE, Q_IN, Q_CONTAINS };
+
+struct Cidr {
+    bool v6;
+    unsigned char addr[16];
+    int bits;
+};
+
+struct QueryNode {
+    enum Kind { AND, OR, NOT, COMPARE } kind = COMPARE;
+    std::vector<QueryNode> children;
+
+    // COMPARE
+    QueryField field = Q_SRC_IP;
+    QueryOp op = Q_EQ;
+    std::vector<std::string> values;   // Lowercase
+    std::vector<Cidr> cidrs;
+    std::vector<double> numbers;
+    std::unordered_set<std::string> signatures;   // Category and severity: signatures that pass
+};
+
+struct Query {
+    QueryNode root;
+    double from = 0, to = 1e18;   // Time range every match lies in
+    double now = -1;              // clock_now relative times were resolved against, -1 without any
+    bool uses_signatures = false;
+    unsigned long long signature_version = 0;   // Of signature_info when category and severity were resolved
+};
+
+// True if text is meant for compile_query rather than the "a,b,-c" substring filter
+bool looks_like_query(const char* text);
+// Nullptr and a message in error if text does not parse. Category and severity
+// are resolved through signature_info (takes mtx), relative times against clock_now.
+std::shared_ptr<const Query> compile_query(const std::string &text, std::string &error);
+// True once signature_info changed or relative times are max_age seconds old: compile again
+bool query_outdated(const Query &query, double max_age);
+
+bool query_matches(const Query &query, const LogInfo &info);
+// Ascending rows of segment that match
+std::vector<uint32_t> query_segment(const Query &query, const Segment &segment);
+// Newest limit matches of one segment not older than threshold, newest first
+std::vector<LogInfo> query_segment_logs(const Query &query, const Segment &segment, size_t limit, double threshold);
+// Newest limit matches in the store, newest first
+std::vector<LogInfo> run_query(const Query &query, SegmentStore &store, size_t limit);
@@ -0,0 +1,148 @@
+#include "replay.hpp"
+#include "core.hpp"
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+
+typedef std::chrono::steady_clock Clock;
+
+// Replay state, guarded by replay_mtx. Never destroyed: the detached reader may
+// still be waiting on replay_cv when main returns.
+static std::mutex &replay_mtx = *new std::mutex;
+static std::condition_variable &replay_cv = *new std::condition_variable;
+static std::atomic<bool> enabled(false);
+static bool started = false, paused = false, rewind_pending = false;
+static double speed = 1, base_time = 0, first_time = 0, end_time = 0;
+static Clock::time_point anchor;
+
+// Caller holds replay_mtx
+static double now_locked() {
+    if (!started || paused) return base_time;
+    return base_time + std::chrono::duration<double>(Clock::now() - anchor).count() * speed;
+}
+
+// Caller holds replay_mtx, restarts the clock from its current value
+static void rebase_locked() {
+    base_time = now_locked();
+    anchor = Clock::now();
+}
+
+void replay_enable(double s) {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    speed = s;
+    enabled = true;
+}
+
+bool replay_enabled() {
+    return enabled;
+}
+
+double clock_now() {
+    if (!enabled) return (double)std::time(0);
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    return now_locked();
+}
+
+double replay_speed() {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    return speed;
+}
+
+bool replay_paused() {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    return paused;
+}
+
+double replay_first_time() {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    return first_time;
+}
+
+double replay_end_time() {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    return end_time;
+}
+
+void replay_set_paused(bool p) {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    rebase_locked();
+    paused = p;
+    replay_cv.notify_all();
+}
+
+void replay_set_speed(double s) {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    rebase_locked();
+    speed = s;
+    replay_cv.notify_all();
+}
+
+void replay_seek(double time) {
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    if (!started) return;
+    if (time < now_locked()) rewind_pending = true;
+    base_time = time;
+    anchor = Clock::now();
+    replay_cv.notify_all();
+}
+
+void replay_open(FILE* file) {
+    // The last complete line fits in the tail of the file unless it is huge
+    const long TAIL = 65536;
+    std::string tail(TAIL, '\0');
+    if (fseek(file, -TAIL, SEEK_END) != 0) fseek(file, 0, SEEK_SET);
+    tail.resize(fread(&tail[0], 1, TAIL, file));
+    fseek(file, 0, SEEK_SET);
+
+    size_t end = tail.find_last_not_of("\r\n");
+    if (end == std::string::npos) return;
+    size_t begin = tail.rfind('\n', end);
+    begin = begin == std::string::npos ? 0 : begin + 1;
+
+    nlohmann::json j = nlohmann::json::parse(tail.substr(begin, end - begin + 1), nullptr, false);
+    if (j.is_discarded()) return;
+    std::lock_guard<std::mutex> lock(replay_mtx);
+    end_time = event_time(j);
+}
+
+double event_time(const nlohmann::json &j) {
+    if (!j.is_object() || !j.contains("timestamp") || !j["timestamp"].is_string()) return -1;
+    std::string timestamp = j["timestamp"];
+    double time = parse_timestamp(timestamp, true, true);
+    if (time == -1) return -1;
+
+    // "2015-03-26T18:00:38.783776-0600": parse_timestamp stops at the seconds
+    if (timestamp.size() > 20 && timestamp[19] == '.') time += atof(timestamp.c_str() + 19);
+    return time;
+}
+
+bool replay_wait(double time) {
+    std::unique_lock<std::mutex> lock(replay_mtx);
+    if (!started) {
+        started = true;
+        first_time = base_time = time;
+        anchor = Clock::now();
+    }
+    while (1) {
+        if (rewind_pending) {
+            rewind_pending = false;
+            return false;
+        }
+        // Also true while paused, so a seek fast-forwards through earlier events
+        double now = now_locked();
+        if (now >= time) return true;
+
+        // Woken early by pause, speed and seek changes
+        if (paused) replay_cv.wait(lock);
+        else replay_cv.wait_for(lock, std::chrono::duration<double>((time - now) / speed));
+    }
+}
+
+bool replay_wait_rewind(int ms) {
+    std::unique_lock<std::mutex> lock(replay_mtx);
+    bool pending = replay_cv.wait_for(lock, std::chrono::milliseconds(ms), [] { return rewind_pending; });
+    rewind_pending = false;
+    return pending;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdio>
+#include "json.hpp"
+
+// Replay mode: the reader releases each event when the replay clock reaches its
+// timestamp. The clock runs at speed x wall time from where it was last anchored
+// (first event, pause, speed change or seek).
+
+// Turns replay on, call before start_pipeline
+void replay_enable(double speed);
+bool replay_enabled();
+
+// Wall clock, or the replay clock while replaying. Used wherever "now" means event time.
+double clock_now();
+
+double replay_speed();
+bool replay_paused();
+// Range of the file being replayed, 0 until known
+double replay_first_time();
+double replay_end_time();
+
+void replay_set_paused(bool paused);
+void replay_set_speed(double speed);
+// Moves the clock to time. Going back makes the reader rewind and rebuild the aggregates.
+void replay_seek(double time);
+
+// Reader side
+// Reads the timestamp of the last line for the seek range, leaves the file at its start
+void replay_open(FILE* file);
+// Event time with fractional seconds, -1 if missing
+double event_time(const nlohmann::json &j);
+// Blocks until the clock reaches time. False if a backward seek wants the file rewound.
+bool replay_wait(double time);
+// Sleep of the reader at EOF: waits up to ms for a rewind request and consumes it
+bool replay_wait_rewind(int ms);
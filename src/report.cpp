@@ -0,0 +1,141 @@
+#include "report.hpp"
+#include "core.hpp"
+#include "metrics.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <ctime>
+
+void print_data(ReportOptions options) {
+    trace_thread_name("report");
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output, std::ios::app);
+        if (!file) std::cerr << "ERROR: cannot open " << options.output << ", writing to stdout" << std::endl;
+    }
+    std::ostream &out = file.is_open() ? file : std::cout;
+
+    const char* names[] = {"src_ip", "dest_ip", "country", "signature", "tag"};
+    const char* titles[] = {"Top source IP", "Top destination IP", "Top country", "Top signature", "Top tag"};
+    std::map<std::string, long long>* totals[] = {&src_ip_total, &dest_ip_total, &country_total, &signature_total, &tag_total};
+
+    long long last_read = 0, last_parsed = 0, last_sum = 0;
+    double last_bucket = 0;
+    auto last_time = std::chrono::steady_clock::now();
+    while (1) {
+        std::this_thread::sleep_for(std::chrono::seconds(options.interval));
+
+        long long s = 0;
+        std::vector<sll> tops[5];
+        std::vector<std::pair<double, long long>> buckets;
+        {
+            TracedLock lock(mtx);
+            s = sum;
+            if (options.top > 0) {
+                tops[0] = top_ips(src_ip_total, src_ip_cold, options.top);
+                tops[1] = top_ips(dest_ip_total, dest_ip_cold, options.top);
+                for (int i = 2; i < 5; i++) tops[i] = top_n(*totals[i], options.top);
+            }
+            if (options.top > 0) {
+                buckets.assign(attacks_per_minute.lower_bound(last_bucket), attacks_per_minute.end());
+                if (!buckets.empty()) last_bucket = buckets.back().first;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - last_time).count();
+        long long read = events_read, parsed = alerts_parsed;
+        double read_rate = (read - last_read) / seconds;
+        double parsed_rate = (parsed - last_parsed) / seconds;
+        double sum_rate = (s - last_sum) / seconds;
+        last_time = now;
+        last_read = read;
+        last_parsed = parsed;
+        last_sum = s;
+
+        if (options.json) {
+            nlohmann::json report = {
+                {"time", (long long)std::time(0)},
+                {"events_read", read}, {"events_read_per_sec", read_rate},
+                {"alerts_parsed", parsed}, {"alerts_parsed_per_sec", parsed_rate},
+                {"alerts_aggregated", s}, {"alerts_aggregated_per_sec", sum_rate},
+                {"read_queue", read_queue.size()}, {"parsed_queue", parsed_queue.size()},
+                {"geo_reloads", (long long)geo_reload_count}, {"tag_reloads", (long long)tag_reload_count},
+                {"pipeline", pipeline_metrics_json()},
+                {"memory", memory_json()}
+            };
+            if (options.top > 0) {
+                for (int i = 0; i < 5; i++) {
+                    nlohmann::json list = nlohmann::json::array();
+                    for (const auto &[name, count] : tops[i]) list.push_back({{"name", name}, {"count", count}});
+                    report[std::string("top_") + names[i]] = list;
+                }
+                nlohmann::json list = nlohmann::json::array();
+                for (const auto &[time, count] : buckets) list.push_back({{"time", (long long)time}, {"count", count}});
+                report["attacks_per_minute"] = list;
+            }
+            if (replay_enabled()) report["replay_time"] = clock_now();
+            out << report.dump() << std::endl;
+            continue;
+        }
+
+        out << "\n================*******================" << std::endl;
+        out << "Events read: " << read << " (" << read_rate << "/s) | Alerts parsed: " << parsed << " (" << parsed_rate << "/s)"
+            << " | Aggregated: " << s << " (" << sum_rate << "/s)" << std::endl;
+        if (replay_enabled()) out << "Replay time: " << format_time(clock_now(), true, true) << " (" << replay_speed() << "x)" << std::endl;
+        out << "Queues: read " << read_queue.size() << ", parsed " << parsed_queue.size() << std::endl;
+        out << "Geo DB reloads: " << geo_reload_count << " (last " << geo_reload_us / 1000.0 << " ms)" << std::endl;
+        out << "Tag DB reloads: " << tag_reload_count << " (last " << tag_reload_us / 1000.0 << " ms)" << std::endl;
+        for (const auto &stage : stage_metrics) {
+            if (stage.in == 0) continue;
+            uint64_t busy = stage.busy_ticks, idle = stage.idle_ticks;
+            out << "Stage " << stage.name << ": in " << stage.in << ", out " << stage.out
+                << ", busy " << (busy + idle ? 100.0 * busy / (busy + idle) : 0.0) << "%"
+                << ", service p50/p99/max " << stage.service.percentile_ns(0.5) / 1000 << "/"
+                << stage.service.percentile_ns(0.99) / 1000 << "/" << stage.service.max_ns() / 1000 << " us" << std::endl;
+        }
+        out << "Read -> aggregated p50/p99/max: " << read_to_aggregated.percentile_ns(0.5) / 1000 << "/"
+            << read_to_aggregated.percentile_ns(0.99) / 1000 << "/" << read_to_aggregated.max_ns() / 1000 << " us" << std::endl;
+        out << "Memory: " << memory_total() / 1048576.0 << " MB";
+        if (memory_budget > 0) {
+            out << " of " << memory_budget / 1048576.0 << " MB budget, evicted " << evicted_minute_buckets << " minute and "
+                << evicted_hour_buckets << " hour buckets, " << collapsed_ips << " cold IPs";
+        }
+        out << std::endl;
+        if (options.top > 0) {
+            for (int i = 0; i < 5; i++) {
+                out << "- " << titles[i] << ":" << std::endl;
+                for (const auto &[name, count] : tops[i]) out << "     " << name << ": " << count << std::endl;
+            }
+            out << "- Attacks per minute:" << std::endl;
+            for (const auto &[time, count] : buckets) out << "     " << format_time(time, true) << ": " << count << std::endl;
+        }
+        out << "===========================================" << std::endl;
+    }
+}
+
+void print_logs(const ReportOptions &options, const std::vector<LogInfo> &logs) {
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output, std::ios::app);
+        if (!file) std::cerr << "ERROR: cannot open " << options.output << ", writing to stdout" << std::endl;
+    }
+    std::ostream &out = file.is_open() ? file : std::cout;
+
+    for (const auto &log : logs) {
+        if (options.json) {
+            nlohmann::json line = {
+                {"time", (long long)log.timestamp}, {"src_ip", log.src_ip}, {"dest_ip", log.dest_ip},
+                {"country", log.country}, {"signature", log.signature}, {"tags", log.tags}
+            };
+            out << line.dump() << "\n";
+        }
+        else out << log.time_text << " | " << log.src_ip << " -> " << log.dest_ip << " | " << log.country << " | " << log.signature
+                 << (log.tags.empty() ? "" : " | " + log.tags) << "\n";
+    }
+    out.flush();
+}
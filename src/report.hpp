@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct LogInfo;
+
+// Periodic stats report, see print_data
+struct ReportOptions {
+    int interval = 5;       // Seconds between reports
+    int top = 0;            // Entries per top-N list, 0 = summary only
+    bool json = false;      // One NDJSON object per report instead of text
+    std::string output;     // File to append to, empty = stdout
+};
+
+// Writes a report every interval: pipeline throughput, top-N lists and the
+// minute buckets changed since the previous report. Never returns.
+void print_data(ReportOptions options);
+
+// Writes alerts, one line of text or one NDJSON object each
+void print_logs(const ReportOptions &options, const std::vector<LogInfo> &logs);
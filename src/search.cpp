@@ -0,0 +1,114 @@
+#include "search.hpp"
+#include "core.hpp"
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <cctype>
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+bool contains(const std::string &hay, const std::string &needle) {
+    size_t n = hay.size(), k = needle.size();
+    if (k == 0) return true;
+    if (k > n) return false;
+    size_t i = 0;
+    #if defined(__SSE2__)
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[k - 1]);
+        for (; i + k - 1 + 16 <= n; i += 16) {
+            __m128i block_first = _mm_loadu_si128((const __m128i*)(hay.data() + i));
+            __m128i block_last = _mm_loadu_si128((const __m128i*)(hay.data() + i + k - 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+            while (mask) {
+                int bit = __builtin_ctz(mask);
+                if (k <= 2 || memcmp(hay.data() + i + bit + 1, needle.data() + 1, k - 2) == 0) return true;
+                mask &= mask - 1;
+            }
+        }
+    #endif
+    return hay.find(needle, i) != std::string::npos;
+}
+
+// Names accepted before '=' in a field term
+static const struct {
+    const char* name;
+    SearchField field;
+} FIELD_NAMES[] = {
+    {"src", FIELD_SRC_IP}, {"src_ip", FIELD_SRC_IP}, {"dest", FIELD_DEST_IP}, {"dst", FIELD_DEST_IP}, {"dest_ip", FIELD_DEST_IP},
+    {"country", FIELD_COUNTRY}, {"sig", FIELD_SIGNATURE}, {"signature", FIELD_SIGNATURE}, {"tag", FIELD_TAG}
+};
+
+static bool parse_field_term(const std::string &term, bool exclude, FieldTerm &field_term) {
+    size_t eq = term.find('=');
+    if (eq == std::string::npos) return false;
+    std::string name = term.substr(0, eq);
+    name.erase(name.find_last_not_of(' ') + 1);
+    std::string value = term.substr(eq + 1);
+    value.erase(0, value.find_first_not_of(' '));
+    if (value.empty()) return false;
+    for (const auto &field : FIELD_NAMES) {
+        if (name != field.name) continue;
+        field_term.field = field.field;
+        field_term.value = value;
+        field_term.exclude = exclude;
+        return true;
+    }
+    return false;
+}
+
+SearchTerms parse_search_terms(const char* text) {
+    SearchTerms terms;
+    std::string term;
+    std::istringstream ss(text);
+    while (std::getline(ss, term, ',')) {
+        term.erase(0, term.find_first_not_of(' '));
+        term.erase(term.find_last_not_of(' ') + 1);
+        std::transform(term.begin(), term.end(), term.begin(), ::tolower);
+        if (term.empty() || term == "-") continue;
+        bool exclude = term[0] == '-';
+        FieldTerm field_term;
+        if (parse_field_term(exclude ? term.substr(1) : term, exclude, field_term)) terms.fields.push_back(field_term);
+        else if (exclude) terms.exclude.push_back(term.substr(1));
+        else terms.include.push_back(term);
+    }
+    return terms;
+}
+
+bool pass_search(const SearchTerms &terms, const std::string &key) {
+    for (const auto &term : terms.exclude) {
+        if (contains(key, term)) return false;
+    }
+    if (terms.include.empty()) return true;
+    for (const auto &term : terms.include) {
+        if (contains(key, term)) return true;
+    }
+    return false;
+}
+
+static bool equals_lower(const char* s, size_t n, const std::string &lower) {
+    if (n != lower.size()) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (tolower((unsigned char)s[i]) != lower[i]) return false;
+    }
+    return true;
+}
+
+bool field_matches(SearchField field, const std::string &stored, const std::string &value) {
+    if (field != FIELD_TAG) return equals_lower(stored.data(), stored.size(), value);
+    for (size_t start = 0; start < stored.size();) {
+        size_t end = stored.find(", ", start);
+        if (end == std::string::npos) end = stored.size();
+        if (equals_lower(stored.data() + start, end - start, value)) return true;
+        start = end + 2;
+    }
+    return false;
+}
+
+bool pass_search(const SearchTerms &terms, const LogInfo &info) {
+    const std::string* values[FIELD_COUNT] = {&info.src_ip, &info.dest_ip, &info.country, &info.signature, &info.tags};
+    for (const auto &term : terms.fields) {
+        if (field_matches(term.field, *values[term.field], term.value) == term.exclude) return false;
+    }
+    return pass_search(terms, info.search_key);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Substring search, SSE2 compares the first and last needle byte 16 positions at a time
+bool contains(const std::string &hay, const std::string &needle);
+
+struct LogInfo;
+
+// Exact-match terms, "src=1.2.3.4" or "-country=united states". Same order as SegmentColumn.
+enum SearchField { FIELD_SRC_IP, FIELD_DEST_IP, FIELD_COUNTRY, FIELD_SIGNATURE, FIELD_TAG, FIELD_COUNT };
+
+struct FieldTerm {
+    SearchField field;
+    std::string value;
+    bool exclude = false;
+};
+
+// Log filter terms, same "a,b,-c" syntax as ImGuiTextFilter, lowercased once.
+// Substring terms are ORed, field terms must all hold on top of them.
+struct SearchTerms {
+    std::vector<std::string> include, exclude;
+    std::vector<FieldTerm> fields;
+};
+
+SearchTerms parse_search_terms(const char* text);
+bool pass_search(const SearchTerms &terms, const std::string &key);
+// Case-insensitive equality, a tag term matches one tag of the "a, b" list
+bool field_matches(SearchField field, const std::string &stored, const std::string &value);
+// Substring terms against search_key and field terms against the fields
+bool pass_search(const SearchTerms &terms, const LogInfo &info);
@@ -0,0 +1,940 @@
+#include "segment.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include <algorithm>
+#include <unordered_map>
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <iterator>
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <ctime>
+#include <thread>
+#include <chrono>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+std::shared_ptr<SegmentStore> segment_store;
+
+static const char SEGMENT_MAGIC[4] = {'S', 'S', 'E', 'G'};
+static const uint32_t SEGMENT_VERSION = 3;       // 1 (no postings) and 2 (no trigrams) are still read
+static const size_t MAX_ROWS = 65536;             // Rows buffered per hour before a partial file is written
+static const double GRACE_SECONDS = 600;          // Alert time after its end that an hour stays open for late rows
+static const double MAX_OPEN_SECONDS = 300;       // Wall time rows for a closed hour are batched before merging
+static const int MAX_RETRY_SECONDS = 60;          // Longest wait before a failed write is tried again
+
+// LogInfo field of each SegmentColumn
+static std::string LogInfo::* const COLUMN_FIELDS[SEG_COLUMNS] = {
+    &LogInfo::src_ip, &LogInfo::dest_ip, &LogInfo::country, &LogInfo::signature, &LogInfo::tags
+};
+
+static uint64_t low_bits(size_t n) {
+    return n >= 64 ? ~0ULL : (1ULL << n) - 1;
+}
+
+static void put_varint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+static uint64_t get_varint(const unsigned char* &p, const unsigned char* end) {
+    uint64_t value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) break;
+    }
+    return value;
+}
+
+static uint32_t trigram_key(const std::string &lower, size_t i) {
+    return (uint32_t)(unsigned char)lower[i] << 16 | (uint32_t)(unsigned char)lower[i + 1] << 8 | (unsigned char)lower[i + 2];
+}
+
+// Header bytes present in each version
+static size_t header_size(uint32_t version) {
+    if (version == 1) return offsetof(SegmentHeader, postings_offset);
+    if (version == 2) return offsetof(SegmentHeader, trigrams_offset);
+    return sizeof(SegmentHeader);
+}
+
+// MappedFile
+MappedFile::MappedFile(const std::string &filename) {
+    #ifdef _WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return;
+        }
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (!view) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return;
+        }
+        file_ = file;
+        mapping_ = mapping;
+        data_ = (const char*)view;
+        size_ = (size_t)size.QuadPart;
+    #else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (view != MAP_FAILED) {
+                data_ = (const char*)view;
+                size_ = (size_t)st.st_size;
+            }
+        }
+        close(fd);
+    #endif
+}
+
+MappedFile::~MappedFile() {
+    if (!data_) return;
+    #ifdef _WIN32
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+    #else
+        munmap((void*)data_, size_);
+    #endif
+}
+
+// Segment
+Segment::Segment(const std::string &filename) : file(filename), filename(filename) {
+    const char* data = file.data();
+    size_t size = file.size();
+    if (!data || size < header_size(1)) return;
+
+    const SegmentHeader* h = (const SegmentHeader*)data;
+    if (memcmp(h->magic, SEGMENT_MAGIC, 4) != 0 || h->version < 1 || h->version > SEGMENT_VERSION || h->columns != SEG_COLUMNS) return;
+    if (size < header_size(h->version)) return;
+    bool has_postings = h->version >= 2;
+    bool has_trigrams = h->version >= 3;
+    if (h->time_offset > size || h->time_bytes > size - h->time_offset) return;
+
+    for (int c = 0; c < SEG_COLUMNS; c++) {
+        uint64_t offset = h->column_offset[c];
+        if (offset % 4 != 0 || offset + 4 > size) return;
+        Dictionary &dict = dicts[c];
+        dict.count = *(const uint32_t*)(data + offset);
+        uint64_t offsets_end = offset + 4 + ((uint64_t)dict.count + 1) * 4;
+        if (offsets_end > size) return;
+        dict.offsets = (const uint32_t*)(data + offset + 4);
+        dict.strings = data + offsets_end;
+
+        uint64_t strings_end = offsets_end + dict.offsets[dict.count];
+        uint64_t codes_offset = (strings_end + 3) / 4 * 4;
+        if (codes_offset + (uint64_t)h->rows * 4 > size) return;
+        for (uint32_t i = 0; i < dict.count; i++) {
+            if (dict.offsets[i] > dict.offsets[i + 1]) return;
+        }
+        dict.codes = (const uint32_t*)(data + codes_offset);
+        for (uint32_t row = 0; row < h->rows; row++) {
+            if (dict.codes[row] >= dict.count) return;
+        }
+
+        dict.posting_offsets = nullptr;
+        dict.postings = nullptr;
+        dict.trigram_count = 0;
+        if (!has_postings) continue;
+        uint64_t postings = h->postings_offset[c];
+        uint64_t postings_start = postings + ((uint64_t)dict.count + 1) * 4;
+        if (postings % 4 != 0 || postings_start > size) return;
+        dict.posting_offsets = (const uint32_t*)(data + postings);
+        dict.postings = (const unsigned char*)data + postings_start;
+        if (postings_start + dict.posting_offsets[dict.count] > size) return;
+        for (uint32_t i = 0; i < dict.count; i++) {
+            if (dict.posting_offsets[i] > dict.posting_offsets[i + 1]) return;
+        }
+
+        if (!has_trigrams) continue;
+        uint64_t trigrams = h->trigrams_offset[c];
+        if (trigrams % 4 != 0 || trigrams + 4 > size) return;
+        uint32_t count = *(const uint32_t*)(data + trigrams);
+        uint64_t lists_start = trigrams + 4 + (uint64_t)count * 4 + ((uint64_t)count + 1) * 4;
+        if (lists_start > size) return;
+        dict.trigram_keys = (const uint32_t*)(data + trigrams + 4);
+        dict.trigram_offsets = dict.trigram_keys + count;
+        dict.trigram_codes = (const unsigned char*)data + lists_start;
+        if (lists_start + dict.trigram_offsets[count] > size) return;
+        for (uint32_t i = 0; i < count; i++) {
+            if (dict.trigram_offsets[i] > dict.trigram_offsets[i + 1]) return;
+        }
+        dict.trigram_count = count;
+    }
+    header = h;
+}
+
+std::string Segment::dictionary_value(SegmentColumn column, uint32_t code) const {
+    const Dictionary &dict = dicts[column];
+    return std::string(dict.strings + dict.offsets[code], dict.offsets[code + 1] - dict.offsets[code]);
+}
+
+long long Segment::find(SegmentColumn column, const std::string &value) const {
+    const Dictionary &dict = dicts[column];
+    uint32_t low = 0, high = dict.count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        const char* s = dict.strings + dict.offsets[mid];
+        size_t length = dict.offsets[mid + 1] - dict.offsets[mid];
+        int cmp = value.compare(0, std::string::npos, s, length);
+        if (cmp == 0) return mid;
+        if (cmp > 0) low = mid + 1;
+        else high = mid;
+    }
+    return -1;
+}
+
+std::vector<double> Segment::times() const {
+    std::vector<double> result;
+    result.reserve(header->rows);
+    const unsigned char* p = (const unsigned char*)file.data() + header->time_offset;
+    const unsigned char* end = p + header->time_bytes;
+    long long previous = (long long)header->min_time;
+    while (result.size() < header->rows && p < end) {
+        uint64_t zigzag = get_varint(p, end);
+        previous += (long long)(zigzag >> 1) ^ -(long long)(zigzag & 1);
+        result.push_back((double)previous);
+    }
+    result.resize(header->rows, header->max_time);
+    return result;
+}
+
+LogInfo Segment::log(uint32_t row, double time) const {
+    LogInfo info;
+    info.timestamp = time;
+    format_time_buf(info.time_text, sizeof(info.time_text), time, true, true);
+    for (int c = 0; c < SEG_COLUMNS; c++) info.*COLUMN_FIELDS[c] = dictionary_value((SegmentColumn)c, code((SegmentColumn)c, row));
+    return info;
+}
+
+std::vector<uint32_t> Segment::postings(SegmentColumn column, uint32_t code) const {
+    const Dictionary &dict = dicts[column];
+    std::vector<uint32_t> rows;
+    if (!dict.posting_offsets) {
+        for (uint32_t row = 0; row < header->rows; row++) {
+            if (dict.codes[row] == code) rows.push_back(row);
+        }
+        return rows;
+    }
+
+    const unsigned char* p = dict.postings + dict.posting_offsets[code];
+    const unsigned char* end = dict.postings + dict.posting_offsets[code + 1];
+    uint64_t row = 0;
+    while (p < end) {
+        row += get_varint(p, end);
+        if (row >= header->rows) break;
+        rows.push_back((uint32_t)row);
+    }
+    return rows;
+}
+
+uint32_t Segment::posting_size(SegmentColumn column, uint32_t code) const {
+    const Dictionary &dict = dicts[column];
+    // Every row takes at least one byte
+    if (dict.posting_offsets) return dict.posting_offsets[code + 1] - dict.posting_offsets[code];
+    return header->rows;
+}
+
+std::vector<uint32_t> Segment::trigram_list(const Dictionary &dict, uint32_t trigram) const {
+    std::vector<uint32_t> codes;
+    const uint32_t* keys_end = dict.trigram_keys + dict.trigram_count;
+    const uint32_t* it = std::lower_bound(dict.trigram_keys, keys_end, trigram);
+    if (it == keys_end || *it != trigram) return codes;
+    size_t i = it - dict.trigram_keys;
+    const unsigned char* p = dict.trigram_codes + dict.trigram_offsets[i];
+    const unsigned char* end = dict.trigram_codes + dict.trigram_offsets[i + 1];
+    uint64_t code = 0;
+    while (p < end) {
+        code += get_varint(p, end);
+        if (code >= dict.count) break;
+        codes.push_back((uint32_t)code);
+    }
+    return codes;
+}
+
+std::vector<uint32_t> Segment::substring_codes(SegmentColumn column, const std::string &term) const {
+    const Dictionary &dict = dicts[column];
+    std::vector<uint32_t> candidates;
+    bool narrowed = dict.trigram_count > 0 && term.size() >= 3;
+    if (narrowed) {
+        // Every trigram of the term must occur in a match, intersect their code lists
+        std::vector<uint32_t> trigrams;
+        for (size_t i = 0; i + 3 <= term.size(); i++) trigrams.push_back(trigram_key(term, i));
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        for (size_t t = 0; t < trigrams.size(); t++) {
+            std::vector<uint32_t> codes = trigram_list(dict, trigrams[t]);
+            if (t == 0) candidates.swap(codes);
+            else {
+                std::vector<uint32_t> both;
+                std::set_intersection(candidates.begin(), candidates.end(), codes.begin(), codes.end(), std::back_inserter(both));
+                candidates.swap(both);
+            }
+            if (candidates.empty()) return candidates;
+        }
+    }
+
+    // Trigrams can match out of order, so candidates are verified
+    std::vector<uint32_t> codes;
+    std::string lower;
+    size_t count = narrowed ? candidates.size() : dict.count;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t code = narrowed ? candidates[i] : (uint32_t)i;
+        lower.assign(dict.strings + dict.offsets[code], dict.offsets[code + 1] - dict.offsets[code]);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (contains(lower, term)) codes.push_back(code);
+    }
+    return codes;
+}
+
+std::vector<uint32_t> Segment::field_codes(const FieldTerm &term) const {
+    SegmentColumn column = (SegmentColumn)term.field;
+    std::vector<uint32_t> codes;
+    // IPs are stored lowercase, so the sorted dictionary finds them directly.
+    // The other dictionaries are small and compared case-insensitively.
+    if (column == SEG_SRC_IP || column == SEG_DEST_IP) {
+        long long code = find(column, term.value);
+        if (code >= 0) codes.push_back((uint32_t)code);
+        return codes;
+    }
+    for (uint32_t code = 0; code < dicts[column].count; code++) {
+        if (field_matches(term.field, dictionary_value(column, code), term.value)) codes.push_back(code);
+    }
+    return codes;
+}
+
+std::vector<uint32_t> Segment::match_fields(const std::vector<FieldTerm> &fields) const {
+    // Each term's rows are the union of its codes' postings
+    std::vector<std::vector<uint32_t>> lists;
+    for (const auto &term : fields) {
+        if (term.exclude) continue;
+        std::vector<uint32_t> rows;
+        for (uint32_t code : field_codes(term)) {
+            std::vector<uint32_t> more = postings((SegmentColumn)term.field, code);
+            std::vector<uint32_t> merged;
+            merged.reserve(rows.size() + more.size());
+            std::merge(rows.begin(), rows.end(), more.begin(), more.end(), std::back_inserter(merged));
+            rows.swap(merged);
+        }
+        if (rows.empty()) return rows;
+        lists.push_back(std::move(rows));
+    }
+    if (lists.empty()) return {};
+
+    // Intersect starting from the shortest list, so the work is bounded by the rarest term
+    std::sort(lists.begin(), lists.end(), [](const auto &a, const auto &b) { return a.size() < b.size(); });
+    std::vector<uint32_t> result = std::move(lists[0]);
+    for (size_t i = 1; i < lists.size() && !result.empty(); i++) {
+        std::vector<uint32_t> both;
+        std::set_intersection(result.begin(), result.end(), lists[i].begin(), lists[i].end(), std::back_inserter(both));
+        result.swap(both);
+    }
+    return result;
+}
+
+// SegmentStore
+SegmentStore::SegmentStore(const std::string &dir, bool writable) : dir(dir), writable(writable) {
+    std::error_code ec;
+    if (writable) std::filesystem::create_directories(dir, ec);
+    for (const auto &entry : std::filesystem::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".seg") continue;
+        auto segment = std::make_shared<const Segment>(entry.path().string());
+        if (segment->valid()) add_segment(segment);
+        else std::cerr << "WARNING: skipping invalid segment " << entry.path().string() << std::endl;
+    }
+
+    std::ifstream file(dir + "/input.id");
+    std::string name;
+    if (std::getline(file, input_id)) {
+        while (std::getline(file, name)) base_files.insert(name);
+    }
+}
+
+void SegmentStore::add_segment(std::shared_ptr<const Segment> segment) {
+    std::lock_guard<std::mutex> lock(segments_mtx);
+    auto it = std::upper_bound(segments.begin(), segments.end(), segment, [](const auto &a, const auto &b) {
+        return a->max_time() < b->max_time();
+    });
+    segments.insert(it, segment);
+}
+
+std::vector<std::shared_ptr<const Segment>> SegmentStore::list() {
+    std::lock_guard<std::mutex> lock(segments_mtx);
+    return segments;
+}
+
+size_t SegmentStore::segment_count() {
+    std::lock_guard<std::mutex> lock(segments_mtx);
+    return segments.size();
+}
+
+long long SegmentStore::row_count() {
+    std::lock_guard<std::mutex> lock(segments_mtx);
+    long long rows = 0;
+    for (const auto &segment : segments) rows += segment->rows();
+    return rows;
+}
+
+static std::string file_name(const std::string &path) {
+    return std::filesystem::path(path).filename().string();
+}
+
+void SegmentStore::snapshot(std::vector<std::shared_ptr<const Segment>> &list, std::vector<LogInfo> &pending) {
+    // The writer swaps segments and drops its batch under write_mtx
+    std::lock_guard<std::mutex> lock(write_mtx);
+    list = this->list();
+    pending.clear();
+    for (const auto &batch : queued) pending.insert(pending.end(), batch.rows.begin(), batch.rows.end());
+    for (const auto &[hour, buffer] : open_hours) pending.insert(pending.end(), buffer.rows.begin(), buffer.rows.end());
+}
+
+void SegmentStore::snapshot(std::vector<std::string> &files, std::vector<LogInfo> &pending) {
+    std::vector<std::shared_ptr<const Segment>> list;
+    snapshot(list, pending);
+    files.clear();
+    for (const auto &segment : list) files.push_back(file_name(segment->filename));
+}
+
+void SegmentStore::hold_superseded() {
+    std::lock_guard<std::mutex> lock(write_mtx);
+    keep_superseded = true;
+}
+
+void SegmentStore::release_superseded(const std::vector<std::string> &files) {
+    std::lock_guard<std::mutex> lock(write_mtx);
+    for (auto it = superseded.begin(); it != superseded.end();) {
+        if (std::find(files.begin(), files.end(), it->second) == files.end()) {
+            ++it;
+            continue;
+        }
+        std::error_code ec;
+        std::filesystem::remove(it->first, ec);
+        it = superseded.erase(it);
+    }
+}
+
+void SegmentStore::keep_only(const std::vector<std::string> &names) {
+    if (!writable) return;
+    std::lock_guard<std::mutex> lock(segments_mtx);
+    for (auto it = segments.begin(); it != segments.end();) {
+        std::string name = file_name((*it)->filename);
+        if (std::find(names.begin(), names.end(), name) != names.end()) {
+            ++it;
+            continue;
+        }
+        std::error_code ec;
+        std::string filename = (*it)->filename;
+        it = segments.erase(it);
+        std::filesystem::remove(filename, ec);
+    }
+}
+
+bool SegmentStore::set_input(const std::string &input, const std::vector<std::string> &base) {
+    if (!writable) return false;
+    // Renamed over the old one, so a crash never leaves a half-written record
+    std::string filename = dir + "/input.id", tmp = filename + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        file << input << "\n";
+        for (const auto &name : base) file << name << "\n";
+        if (!file.flush()) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, filename, ec);
+    if (ec) return false;
+    input_id = input;
+    base_files = std::set<std::string>(base.begin(), base.end());
+    return true;
+}
+
+size_t SegmentStore::drop_input() {
+    std::vector<std::string> keep;
+    size_t dropped = 0;
+    for (const auto &segment : list()) {
+        if (base_files.count(file_name(segment->filename))) keep.push_back(file_name(segment->filename));
+        else dropped++;
+    }
+    keep_only(keep);
+    return dropped;
+}
+
+void SegmentStore::restore_pending(const std::vector<LogInfo> &rows) {
+    if (!writable) return;
+    std::lock_guard<std::mutex> lock(write_mtx);
+    double now = (double)std::time(0);
+    for (const auto &info : rows) {
+        SegmentBuffer &buffer = open_hours[std::floor(info.timestamp / 3600) * 3600];
+        if (buffer.rows.empty()) buffer.opened = now;
+        buffer.rows.push_back(info);
+        memory_stats[MEM_STORE_BUFFERS].add(1, log_bytes(info));
+        newest_time = std::max(newest_time, info.timestamp);
+    }
+}
+
+static void put_u32(std::string &out, uint32_t value) {
+    out.append((const char*)&value, 4);
+}
+
+std::shared_ptr<const Segment> SegmentStore::write_segment(double hour, const std::vector<LogInfo> &rows) {
+    TRACE_ZONE("write segment");
+    SegmentHeader header = {};
+    memcpy(header.magic, SEGMENT_MAGIC, 4);
+    header.version = SEGMENT_VERSION;
+    header.rows = (uint32_t)rows.size();
+    header.columns = SEG_COLUMNS;
+    header.min_time = header.max_time = rows[0].timestamp;
+    for (const auto &row : rows) {
+        header.min_time = std::min(header.min_time, row.timestamp);
+        header.max_time = std::max(header.max_time, row.timestamp);
+    }
+
+    std::string out(sizeof(SegmentHeader), '\0');
+
+    // Time column
+    header.time_offset = out.size();
+    long long previous = (long long)header.min_time;
+    for (const auto &row : rows) {
+        long long delta = (long long)row.timestamp - previous;
+        previous = (long long)row.timestamp;
+        put_varint(out, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    }
+    header.time_bytes = out.size() - header.time_offset;
+
+    // Dictionary columns
+    for (int c = 0; c < SEG_COLUMNS; c++) {
+        out.resize((out.size() + 3) / 4 * 4, '\0');
+        header.column_offset[c] = out.size();
+
+        std::vector<std::string> values;
+        std::unordered_map<std::string, uint32_t> codes;
+        for (const auto &row : rows) {
+            if (codes.emplace(row.*COLUMN_FIELDS[c], 0).second) values.push_back(row.*COLUMN_FIELDS[c]);
+        }
+        std::sort(values.begin(), values.end());
+        for (uint32_t i = 0; i < values.size(); i++) codes[values[i]] = i;
+
+        put_u32(out, (uint32_t)values.size());
+        uint32_t offset = 0;
+        put_u32(out, 0);
+        for (const auto &value : values) {
+            offset += (uint32_t)value.size();
+            put_u32(out, offset);
+        }
+        for (const auto &value : values) out += value;
+        out.resize((out.size() + 3) / 4 * 4, '\0');
+        std::vector<uint32_t> row_codes;
+        row_codes.reserve(rows.size());
+        for (const auto &row : rows) row_codes.push_back(codes[row.*COLUMN_FIELDS[c]]);
+        for (uint32_t code : row_codes) put_u32(out, code);
+
+        // Postings: rows grouped by code, each group already ascending
+        std::vector<std::vector<uint32_t>> rows_of(values.size());
+        for (uint32_t row = 0; row < row_codes.size(); row++) rows_of[row_codes[row]].push_back(row);
+        std::string postings;
+        std::vector<uint32_t> posting_offsets(1, 0);
+        for (const auto &list : rows_of) {
+            uint32_t previous = 0;
+            for (uint32_t row : list) {
+                put_varint(postings, row - previous);
+                previous = row;
+            }
+            posting_offsets.push_back((uint32_t)postings.size());
+        }
+        out.resize((out.size() + 3) / 4 * 4, '\0');
+        header.postings_offset[c] = out.size();
+        for (uint32_t offset : posting_offsets) put_u32(out, offset);
+        out += postings;
+
+        // Trigrams of the lowercase values, each listing the codes that contain it
+        std::map<uint32_t, std::vector<uint32_t>> trigram_codes;
+        std::string lower;
+        for (uint32_t code = 0; code < values.size(); code++) {
+            lower = values[code];
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            for (size_t i = 0; i + 3 <= lower.size(); i++) {
+                std::vector<uint32_t> &codes = trigram_codes[trigram_key(lower, i)];
+                if (codes.empty() || codes.back() != code) codes.push_back(code);
+            }
+        }
+        std::string lists;
+        std::vector<uint32_t> list_offsets(1, 0);
+        for (const auto &[trigram, codes] : trigram_codes) {
+            uint32_t previous = 0;
+            for (uint32_t code : codes) {
+                put_varint(lists, code - previous);
+                previous = code;
+            }
+            list_offsets.push_back((uint32_t)lists.size());
+        }
+        out.resize((out.size() + 3) / 4 * 4, '\0');
+        header.trigrams_offset[c] = out.size();
+        put_u32(out, (uint32_t)trigram_codes.size());
+        for (const auto &[trigram, codes] : trigram_codes) put_u32(out, trigram);
+        for (uint32_t offset : list_offsets) put_u32(out, offset);
+        out += lists;
+    }
+    memcpy(&out[0], &header, sizeof(header));
+
+    // Written under a temporary name, so a segment file is either complete or absent
+    std::error_code ec;
+    std::string path;
+    for (int seq = 0;; seq++) {
+        path = dir + "/" + std::to_string((long long)hour) + "-" + std::to_string(seq) + ".seg";
+        if (!std::filesystem::exists(path, ec)) break;
+    }
+    std::string tmp = path + ".tmp";
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (!file) {
+        std::cerr << "ERROR: cannot write segment " << tmp << std::endl;
+        return nullptr;
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    ok = fclose(file) == 0 && ok;
+    if (ok) std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec) {
+        std::cerr << "ERROR: cannot write segment " << path << std::endl;
+        std::filesystem::remove(tmp, ec);
+        return nullptr;
+    }
+
+    auto segment = std::make_shared<const Segment>(path);
+    return segment->valid() ? segment : nullptr;
+}
+
+void SegmentStore::queue_batch(double hour, std::vector<LogInfo> rows, bool compact) {
+    queued.push_back({hour, std::move(rows), compact});
+    // The thread keeps the store alive, so it is never destroyed under it
+    if (!writer_started) {
+        writer_started = true;
+        std::thread(&SegmentStore::writer, shared_from_this()).detach();
+    }
+    write_cv.notify_all();
+}
+
+void SegmentStore::writer() {
+    trace_thread_name("segment writer");
+    std::unique_lock<std::mutex> lock(write_mtx);
+    while (true) {
+        write_cv.wait(lock, [this] { return !queued.empty(); });
+        // Only this thread pops, so the front stays put while it is written
+        const SegmentBatch &batch = queued.front();
+        lock.unlock();
+        std::vector<std::shared_ptr<const Segment>> replaced;
+        std::shared_ptr<const Segment> segment = batch.compact ? compact(batch, replaced) : write_segment(batch.hour, batch.rows);
+        if (!segment && !batch.rows.empty()) {
+            // Disk full or not writable: the batch stays queued, so snapshot() still lists its
+            // rows as pending and checkpoints keep them
+            lock.lock();
+            int delay = std::min(MAX_RETRY_SECONDS, 1 << std::min(write_failures++, 6));
+            write_cv.notify_all();
+            std::cerr << "ERROR: " << batch.rows.size() << " alerts not stored, retrying in " << delay << " s" << std::endl;
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::seconds(delay));
+            lock.lock();
+            continue;
+        }
+        long long bytes = 0;
+        for (const auto &row : batch.rows) bytes += log_bytes(row);
+        memory_stats[MEM_STORE_BUFFERS].add(-(long long)batch.rows.size(), -bytes);
+        lock.lock();
+        write_failures = 0;
+        if (segment) {
+            add_segment(segment);
+            std::string name = file_name(segment->filename);
+            {
+                std::lock_guard<std::mutex> segments_lock(segments_mtx);
+                for (const auto &old : replaced) segments.erase(std::find(segments.begin(), segments.end(), old));
+            }
+            for (const auto &old : replaced) {
+                std::error_code ec;
+                if (!keep_superseded) {
+                    std::filesystem::remove(old->filename, ec);
+                    continue;
+                }
+                // A merged file merged again: what it replaced now waits for the newer one
+                for (auto &entry : superseded) {
+                    if (entry.second == file_name(old->filename)) entry.second = name;
+                }
+                superseded.push_back({old->filename, name});
+            }
+        }
+        queued.pop_front();
+        write_cv.notify_all();
+    }
+}
+
+std::shared_ptr<const Segment> SegmentStore::compact(const SegmentBatch &batch, std::vector<std::shared_ptr<const Segment>> &replaced) {
+    TRACE_ZONE("compact segments");
+    // Only this thread adds or removes segments once the pipeline runs
+    for (const auto &segment : list()) {
+        if (std::floor(segment->min_time() / 3600) * 3600 == batch.hour && !base_files.count(file_name(segment->filename))) {
+            replaced.push_back(segment);
+        }
+    }
+    if (replaced.empty()) return batch.rows.empty() ? nullptr : write_segment(batch.hour, batch.rows);
+    if (replaced.size() == 1 && batch.rows.empty()) {
+        replaced.clear();
+        return nullptr;
+    }
+
+    std::vector<LogInfo> rows;
+    for (const auto &segment : replaced) {
+        std::vector<double> times = segment->times();
+        for (uint32_t row = 0; row < segment->rows(); row++) rows.push_back(segment->log(row, times[row]));
+    }
+    rows.insert(rows.end(), batch.rows.begin(), batch.rows.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const LogInfo &a, const LogInfo &b) { return a.timestamp < b.timestamp; });
+    std::shared_ptr<const Segment> segment = write_segment(batch.hour, rows);
+    if (!segment) replaced.clear();
+    return segment;
+}
+
+void SegmentStore::compact_fragmented() {
+    if (!writable) return;
+    std::lock_guard<std::mutex> lock(write_mtx);
+    std::map<double, int> files;
+    for (const auto &segment : list()) {
+        if (!base_files.count(file_name(segment->filename))) files[std::floor(segment->min_time() / 3600) * 3600]++;
+        newest_time = std::max(newest_time, segment->max_time());
+    }
+    // Closed hours restored from a checkpoint are merged with their rows
+    for (auto it = open_hours.begin(); it != open_hours.end();) {
+        if (it->first + 3600 + GRACE_SECONDS > newest_time) break;
+        files.erase(it->first);
+        queue_batch(it->first, std::move(it->second.rows), true);
+        it = open_hours.erase(it);
+    }
+    for (const auto &[hour, count] : files) {
+        if (count > 1 && hour + 3600 + GRACE_SECONDS <= newest_time && !open_hours.count(hour)) queue_batch(hour, {}, true);
+    }
+}
+
+void SegmentStore::append(const LogInfo &info) {
+    if (!writable) return;
+    std::lock_guard<std::mutex> lock(write_mtx);
+    double hour = std::floor(info.timestamp / 3600) * 3600;
+    double now = (double)std::time(0);
+    newest_time = std::max(newest_time, info.timestamp);
+
+    SegmentBuffer &buffer = open_hours[hour];
+    if (buffer.rows.empty()) {
+        buffer.opened = now;
+        buffer.late = hour + 3600 + GRACE_SECONDS <= newest_time;
+    }
+    buffer.rows.push_back(info);
+    buffer.rows.back().search_key.clear();
+    memory_stats[MEM_STORE_BUFFERS].add(1, log_bytes(buffer.rows.back()));
+
+    // A closed hour is merged with its partial files. Late rows wait MAX_OPEN_SECONDS,
+    // so stragglers rewrite the hour's file at most that often.
+    for (auto it = open_hours.begin(); it != open_hours.end();) {
+        SegmentBuffer &open = it->second;
+        bool closed = it->first + 3600 + GRACE_SECONDS <= newest_time;
+        if (closed && (!open.late || now - open.opened >= MAX_OPEN_SECONDS)) queue_batch(it->first, std::move(open.rows), true);
+        else if (open.rows.size() >= MAX_ROWS) queue_batch(it->first, std::move(open.rows), false);
+        else {
+            ++it;
+            continue;
+        }
+        it = open_hours.erase(it);
+    }
+}
+
+void SegmentStore::write_open_hours() {
+    if (!writable) return;
+    std::lock_guard<std::mutex> lock(write_mtx);
+    // Partial files, merged once their hour closes
+    for (auto &[hour, buffer] : open_hours) queue_batch(hour, std::move(buffer.rows), false);
+    open_hours.clear();
+}
+
+void SegmentStore::flush() {
+    if (!writable) return;
+    std::unique_lock<std::mutex> lock(write_mtx);
+    for (auto &[hour, buffer] : open_hours) queue_batch(hour, std::move(buffer.rows), false);
+    open_hours.clear();
+    // A failing disk is not waited for, the last checkpoint holds the queued rows
+    write_cv.wait(lock, [this] { return queued.empty() || write_failures > 0; });
+}
+
+void keep_newest(std::vector<LogInfo> &logs, size_t limit) {
+    std::stable_sort(logs.begin(), logs.end(), [](const LogInfo &a, const LogInfo &b) { return a.timestamp > b.timestamp; });
+    if (logs.size() > limit) logs.resize(limit);
+}
+
+std::vector<LogInfo> search_rows(const std::vector<LogInfo> &rows, const RowMatch &match, double from, double to, size_t limit) {
+    std::vector<LogInfo> result;
+    for (const auto &row : rows) {
+        if (row.timestamp < from || row.timestamp > to) continue;
+        LogInfo info = row;
+        fill_log_text(info);
+        if (match(info)) result.push_back(std::move(info));
+    }
+    keep_newest(result, limit);
+    return result;
+}
+
+std::vector<LogInfo> search_segment(const Segment &segment, const SearchTerms &terms, double from, double to, size_t limit, double threshold) {
+    std::vector<LogInfo> result;
+    if (limit == 0 || segment.max_time() < from || segment.min_time() > to || segment.max_time() < threshold) return result;
+
+    // Terms without a space can't span two fields, so each resolves to the dictionary
+    // codes containing it (through the trigrams) and a row only ORs the bits of its five codes
+    size_t term_count = terms.include.size() + terms.exclude.size();
+    bool per_field = term_count <= 64;
+    for (const auto &term : terms.include) per_field = per_field && term.find(' ') == std::string::npos;
+    for (const auto &term : terms.exclude) per_field = per_field && term.find(' ') == std::string::npos;
+    uint64_t include_bits = low_bits(terms.include.size());
+    uint64_t exclude_bits = low_bits(term_count) & ~include_bits;
+    bool indexed = std::any_of(terms.fields.begin(), terms.fields.end(), [](const FieldTerm &term) { return !term.exclude; });
+
+    // Field terms: the postings give the candidate rows, exclusions mark their codes
+    std::vector<uint32_t> candidates;
+    bool narrowed = indexed;
+    if (indexed) {
+        candidates = segment.match_fields(terms.fields);
+        if (candidates.empty()) return result;
+    }
+    std::vector<char> excluded[SEG_COLUMNS];
+    for (const auto &term : terms.fields) {
+        if (!term.exclude) continue;
+        std::vector<char> &codes = excluded[term.field];
+        codes.resize(segment.dictionary_size((SegmentColumn)term.field));
+        for (uint32_t code : segment.field_codes(term)) codes[code] = 1;
+    }
+
+    std::vector<std::string> dict[SEG_COLUMNS];
+    std::vector<uint64_t> bits[SEG_COLUMNS];
+    if (per_field && term_count > 0) {
+        uint64_t present = 0;   // Terms found in any dictionary string
+        size_t include_rows = 0;   // Upper bound of the rows with an include term
+        std::vector<std::pair<SegmentColumn, uint32_t>> include_codes;
+        for (int c = 0; c < SEG_COLUMNS; c++) {
+            SegmentColumn column = (SegmentColumn)c;
+            bits[c].assign(segment.dictionary_size(column), 0);
+            size_t bit = 0;
+            for (const auto &term : terms.include) {
+                for (uint32_t code : segment.substring_codes(column, term)) {
+                    if (!(bits[c][code] & include_bits)) {
+                        include_codes.push_back({column, code});
+                        include_rows += segment.posting_size(column, code);
+                    }
+                    bits[c][code] |= 1ULL << bit;
+                }
+                bit++;
+            }
+            for (const auto &term : terms.exclude) {
+                for (uint32_t code : segment.substring_codes(column, term)) bits[c][code] |= 1ULL << bit;
+                bit++;
+            }
+            for (uint64_t b : bits[c]) present |= b;
+        }
+        if (include_bits && !(present & include_bits)) return result;
+
+        // Few enough matching rows: take them from the postings instead of scanning
+        if (include_bits && include_rows < segment.rows()) {
+            std::vector<uint32_t> rows;
+            for (const auto &[column, code] : include_codes) {
+                std::vector<uint32_t> more = segment.postings(column, code);
+                rows.insert(rows.end(), more.begin(), more.end());
+            }
+            std::sort(rows.begin(), rows.end());
+            rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+            if (narrowed) {
+                std::vector<uint32_t> both;
+                std::set_intersection(candidates.begin(), candidates.end(), rows.begin(), rows.end(), std::back_inserter(both));
+                rows.swap(both);
+            }
+            candidates.swap(rows);
+            narrowed = true;
+            if (candidates.empty()) return result;
+        }
+    }
+    else if (term_count > 0) {
+        for (int c = 0; c < SEG_COLUMNS; c++) {
+            dict[c].resize(segment.dictionary_size((SegmentColumn)c));
+            for (uint32_t code = 0; code < dict[c].size(); code++) dict[c][code] = segment.dictionary_value((SegmentColumn)c, code);
+        }
+    }
+
+    std::vector<double> times = segment.times();
+    std::string key;
+    size_t count = narrowed ? candidates.size() : segment.rows();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t row = narrowed ? candidates[i] : (uint32_t)i;
+        if (times[row] < from || times[row] > to || times[row] < threshold) continue;
+        bool skip = false;
+        for (int c = 0; c < SEG_COLUMNS && !skip; c++) skip = !excluded[c].empty() && excluded[c][segment.code((SegmentColumn)c, row)];
+        if (skip) continue;
+        if (term_count > 0 && per_field) {
+            uint64_t matched = 0;
+            for (int c = 0; c < SEG_COLUMNS; c++) matched |= bits[c][segment.code((SegmentColumn)c, row)];
+            if (matched & exclude_bits) continue;
+            if (include_bits && !(matched & include_bits)) continue;
+        }
+        else if (term_count > 0) {
+            key.clear();
+            for (int c = 0; c < SEG_COLUMNS; c++) {
+                if (c) key += ' ';
+                key += dict[c][segment.code((SegmentColumn)c, row)];
+            }
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            if (!pass_search(terms, key)) continue;
+        }
+
+        result.push_back(segment.log(row, times[row]));
+    }
+    keep_newest(result, limit);
+    return result;
+}
+
+std::vector<LogInfo> SegmentStore::search(const SegmentSearch &search, const RowMatch &match, size_t limit) {
+    TRACE_ZONE("query segments");
+    std::vector<std::shared_ptr<const Segment>> list;
+    std::vector<LogInfo> pending;
+    snapshot(list, pending);
+    if (limit == 0) return {};
+
+    std::vector<LogInfo> result = search_rows(pending, match, 0, DBL_MAX, limit);
+    double threshold = result.size() >= limit ? result.back().timestamp : -1;   // Time of the limit-th newest match so far
+    for (auto it = list.rbegin(); it != list.rend(); ++it) {
+        if ((*it)->max_time() < threshold) break;   // Sorted by max_time, nothing newer follows
+        std::vector<LogInfo> more = search(**it, limit, threshold);
+        result.insert(result.end(), more.begin(), more.end());
+        // Keep only the newest limit, their oldest time prunes the remaining segments
+        if (result.size() >= limit) {
+            keep_newest(result, limit);
+            threshold = result.back().timestamp;
+        }
+    }
+    keep_newest(result, limit);
+    return result;
+}
+
+std::vector<LogInfo> SegmentStore::query(const SearchTerms &terms, double from, double to, size_t limit) {
+    return search([&](const Segment &segment, size_t limit, double threshold) {
+        return search_segment(segment, terms, from, to, limit, threshold);
+    }, [&](const LogInfo &info) {
+        return info.timestamp >= from && info.timestamp <= to && pass_search(terms, info);
+    }, limit);
+}
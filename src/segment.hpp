@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include "core.hpp"
+#include "search.hpp"
+
+// On-disk alert history: immutable, hour-partitioned columnar segment files.
+// An hour is buffered until GRACE_SECONDS of alert time after it ends, then written
+// as one file together with any partial files it had (MAX_ROWS, flush on exit).
+// Rows that arrive later are batched and merged into the hour's file.
+//
+// <dir>/input.id: the input the store is filled from (see claim_store), then one
+// line per segment file written for earlier inputs
+//
+// <dir>/<hour>-<seq>.seg
+//   SegmentHeader
+//   time column    zigzag varint deltas of whole seconds, the first from min_time
+//   5 dictionary columns (src_ip, dest_ip, country, signature, tags), each:
+//     uint32 count, uint32 offsets[count + 1], string bytes, padding to 4,
+//     uint32 codes[rows]
+//   5 posting sections (version 2), each:
+//     uint32 offsets[count + 1], then per dictionary code the ascending row ids
+//     holding it as varint deltas
+//   5 trigram sections (version 3), each:
+//     uint32 count, uint32 keys[count] (sorted lowercase byte trigrams),
+//     uint32 offsets[count + 1], then per trigram the ascending dictionary
+//     codes containing it as varint deltas
+// Dictionaries are sorted, so a value is found by binary search and a filter is
+// evaluated once per distinct string instead of once per row. Exact-match terms
+// go through the postings and only touch the rows they match. Substring terms
+// resolve to dictionary codes through the trigrams, then to rows through the postings.
+
+enum SegmentColumn { SEG_SRC_IP, SEG_DEST_IP, SEG_COUNTRY, SEG_SIGNATURE, SEG_TAGS, SEG_COLUMNS };
+
+struct SegmentHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t rows;
+    uint32_t columns;
+    double min_time, max_time;
+    uint64_t time_offset, time_bytes;
+    uint64_t column_offset[SEG_COLUMNS];
+    uint64_t postings_offset[SEG_COLUMNS];   // Version 2
+    uint64_t trigrams_offset[SEG_COLUMNS];   // Version 3
+};
+
+// Read-only file mapping, empty if the file can't be opened
+class MappedFile {
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        #ifdef _WIN32
+            void* file_ = nullptr;
+            void* mapping_ = nullptr;
+        #endif
+
+    public:
+        explicit MappedFile(const std::string &filename);
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile &operator=(const MappedFile&) = delete;
+
+        const char* data() const { return data_; }
+        size_t size() const { return size_; }
+};
+
+// One mmapped segment, validated on open
+class Segment {
+    private:
+        MappedFile file;
+        const SegmentHeader* header = nullptr;
+
+        struct Dictionary {
+            uint32_t count;
+            const uint32_t* offsets;
+            const char* strings;
+            const uint32_t* codes;
+            const uint32_t* posting_offsets;   // Null in version 1 segments
+            const unsigned char* postings;
+            uint32_t trigram_count;            // 0 in version 1 and 2 segments
+            const uint32_t* trigram_keys;
+            const uint32_t* trigram_offsets;
+            const unsigned char* trigram_codes;
+        } dicts[SEG_COLUMNS];
+
+        std::vector<uint32_t> trigram_list(const Dictionary &dict, uint32_t trigram) const;
+
+    public:
+        std::string filename;
+
+        explicit Segment(const std::string &filename);
+        bool valid() const { return header != nullptr; }
+        uint32_t rows() const { return header->rows; }
+        double min_time() const { return header->min_time; }
+        double max_time() const { return header->max_time; }
+
+        uint32_t dictionary_size(SegmentColumn column) const { return dicts[column].count; }
+        std::string dictionary_value(SegmentColumn column, uint32_t code) const;
+        // Code of value in the column's dictionary, -1 if no row has it
+        long long find(SegmentColumn column, const std::string &value) const;
+        uint32_t code(SegmentColumn column, uint32_t row) const { return dicts[column].codes[row]; }
+        // Decodes the time column
+        std::vector<double> times() const;
+        // One row as a log table entry, time from times()
+        LogInfo log(uint32_t row, double time) const;
+        // Ascending rows whose column holds code, from the postings (or a scan of the codes in version 1)
+        std::vector<uint32_t> postings(SegmentColumn column, uint32_t code) const;
+        // Upper bound of the rows in postings(column, code), without decoding them
+        uint32_t posting_size(SegmentColumn column, uint32_t code) const;
+        // Codes whose value contains the lowercase term, ignoring case. Terms of 3 bytes or
+        // more are narrowed by the trigrams and verified, shorter ones scan the dictionary.
+        std::vector<uint32_t> substring_codes(SegmentColumn column, const std::string &term) const;
+        // Dictionary codes a field term matches
+        std::vector<uint32_t> field_codes(const FieldTerm &term) const;
+        // Ascending rows matching every field term that is not an exclusion, by intersecting postings
+        std::vector<uint32_t> match_fields(const std::vector<FieldTerm> &fields) const;
+};
+
+// Rows of one hour not written yet
+struct SegmentBuffer {
+    std::vector<LogInfo> rows;
+    double opened = 0;    // Wall time of the first buffered row
+    bool late = false;    // Opened after its hour was closed
+};
+
+// Rows handed to the writer thread
+struct SegmentBatch {
+    double hour;
+    std::vector<LogInfo> rows;
+    bool compact;   // Merged with the hour's segments into one file
+};
+
+// Matches a buffered row, for searches that include rows not written yet
+typedef std::function<bool(const LogInfo &info)> RowMatch;
+// Matches of one segment: newest limit not older than threshold, newest first
+typedef std::function<std::vector<LogInfo>(const Segment &segment, size_t limit, double threshold)> SegmentSearch;
+
+class SegmentStore : public std::enable_shared_from_this<SegmentStore> {
+    private:
+        std::string dir;
+        bool writable;
+        std::mutex segments_mtx, write_mtx;
+        std::condition_variable write_cv;
+        std::vector<std::shared_ptr<const Segment>> segments;   // Guarded by segments_mtx, sorted by max_time
+        std::map<double, SegmentBuffer> open_hours;              // Guarded by write_mtx
+        std::deque<SegmentBatch> queued;                         // Guarded by write_mtx, the front one is being written
+        bool writer_started = false;                             // Guarded by write_mtx
+        int write_failures = 0;                                  // Guarded by write_mtx, failed writes of the front batch in a row
+        double newest_time = 0;                                  // Guarded by write_mtx, newest alert appended
+        // Guarded by write_mtx: files replaced by a merged one (path, replacement name). They
+        // are deleted once a checkpoint lists the replacement, until then a restart from the
+        // previous checkpoint still finds them.
+        std::vector<std::pair<std::string, std::string>> superseded;
+        bool keep_superseded = false;                            // Guarded by write_mtx, else deleted right away
+        // From <dir>/input.id, set before the pipeline starts. Files of earlier inputs are
+        // never merged, so dropping the current input's segments leaves them intact.
+        std::string input_id;
+        std::set<std::string> base_files;
+
+        void add_segment(std::shared_ptr<const Segment> segment);
+        std::shared_ptr<const Segment> write_segment(double hour, const std::vector<LogInfo> &rows);
+        // Rows of batch and of the hour's segments in one file, the merged segments go to replaced
+        std::shared_ptr<const Segment> compact(const SegmentBatch &batch, std::vector<std::shared_ptr<const Segment>> &replaced);
+        // Caller holds write_mtx
+        void queue_batch(double hour, std::vector<LogInfo> rows, bool compact);
+        // Writes queued batches, one thread per store, started with the first batch. A batch
+        // that fails is retried with backoff and only dropped from queued once written.
+        void writer();
+
+    public:
+        SegmentStore(const std::string &dir, bool writable);
+
+        // Called by the aggregating thread for every alert, outside mtx. An hour is handed
+        // to the writer thread once it is closed or at MAX_ROWS rows.
+        void append(const LogInfo &info);
+        // Hands every open hour to the writer without waiting, for the memory budget
+        void write_open_hours();
+        // Writes every open hour and waits for the writer, e.g. before exit
+        void flush();
+
+        bool read_only() const { return !writable; }
+        std::vector<std::shared_ptr<const Segment>> list();
+        size_t segment_count();
+        long long row_count();
+
+        // The segments written so far and the rows in none of them (buffered or queued for
+        // the writer), taken together so no row is in both. Pending rows have no search_key.
+        void snapshot(std::vector<std::shared_ptr<const Segment>> &segments, std::vector<LogInfo> &pending);
+        // Same with file names, for checkpoints
+        void snapshot(std::vector<std::string> &files, std::vector<LogInfo> &pending);
+        // Keeps merged files until release_superseded, for stores restarted from checkpoints
+        void hold_superseded();
+        // After a checkpoint listing files was written: deletes the files their merged replacement made redundant
+        void release_superseded(const std::vector<std::string> &files);
+        // Deletes the segments not in files, they hold lines read after a checkpoint
+        // that the reader is about to read again
+        void keep_only(const std::vector<std::string> &files);
+        // Buffers rows from a checkpoint again, before the pipeline starts
+        void restore_pending(const std::vector<LogInfo> &rows);
+        // Identity of the recorded input, empty when the store has no input.id
+        const std::string &input() const { return input_id; }
+        // Records the input the store is filled from from now on, base are the files of earlier inputs
+        bool set_input(const std::string &input, const std::vector<std::string> &base);
+        // Deletes the segments written for the recorded input, before it is read from the start
+        // again. Returns how many.
+        size_t drop_input();
+        // Merges closed hours left in several files by earlier runs, when the pipeline starts
+        void compact_fragmented();
+
+        // Newest limit alerts, newest first: search runs on each segment, newest first, until
+        // none can hold a newer match, and match filters the rows not written yet.
+        std::vector<LogInfo> search(const SegmentSearch &search, const RowMatch &match, size_t limit);
+        // Newest limit alerts in [from, to] whose search key passes terms, newest first.
+        // Includes the rows not written yet.
+        std::vector<LogInfo> query(const SearchTerms &terms, double from, double to, size_t limit);
+};
+
+// Sorts logs newest first and drops all but the newest limit
+void keep_newest(std::vector<LogInfo> &logs, size_t limit);
+// Newest limit of rows (pending rows of a store) in [from, to] that match
+std::vector<LogInfo> search_rows(const std::vector<LogInfo> &rows, const RowMatch &match, double from, double to, size_t limit);
+// Newest limit alerts of one segment in [from, to] and not older than threshold
+// whose search key passes terms. SegmentStore::query searches with it.
+std::vector<LogInfo> search_segment(const Segment &segment, const SearchTerms &terms, double from, double to, size_t limit, double threshold);
+
+// Open when --store was given, set before start_pipeline
+extern std::shared_ptr<SegmentStore> segment_store;
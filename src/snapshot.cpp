@@ -0,0 +1,77 @@
+#include "snapshot.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include <algorithm>
+#include <ctime>
+
+std::shared_ptr<const TopSnapshot> top_snapshot;
+std::atomic<int> top_snapshot_n(0);
+
+std::shared_ptr<const BarSnapshot> make_bar_snapshot(const BarDetail &bar, double time, bool hour, long long attacks) {
+    auto snapshot = std::make_shared<BarSnapshot>();
+    snapshot->time = time;
+    snapshot->hour = hour;
+    snapshot->attacks = attacks;
+    snapshot->src_count.assign(bar.src_count.begin(), bar.src_count.end());
+    snapshot->dest_count.assign(bar.dest_count.begin(), bar.dest_count.end());
+    snapshot->signature_count.assign(bar.signature_count.begin(), bar.signature_count.end());
+    snapshot->country_count.assign(bar.country_count.begin(), bar.country_count.end());
+    snapshot->tag_count.assign(bar.tag_count.begin(), bar.tag_count.end());
+    desc_sort(snapshot->src_count);
+    desc_sort(snapshot->dest_count);
+    desc_sort(snapshot->signature_count);
+    desc_sort(snapshot->country_count);
+    desc_sort(snapshot->tag_count);
+    return snapshot;
+}
+
+std::shared_ptr<const SignatureSnapshot> make_signature_snapshot() {
+    auto snapshot = std::make_shared<SignatureSnapshot>();
+    {
+        TracedLock lock(mtx);
+        snapshot->rows.reserve(signature_total.size());
+        // Runs on the GUI thread: look up without inserting into signature_info
+        static const SignatureInfo missing;
+        for (const auto &[signature, count] : signature_total) {
+            auto found = signature_info.find(signature);
+            const SignatureInfo &info = found != signature_info.end() ? found->second : missing;
+            snapshot->rows.push_back({signature, info.category, info.severity, info.last_seen, count});
+        }
+    }
+
+    const std::vector<SignatureRow> &rows = snapshot->rows;
+    for (int column = 0; column < 5; column++) {
+        std::vector<int> &order = snapshot->order[column];
+        order.resize(rows.size());
+        for (size_t i = 0; i < rows.size(); i++) order[i] = (int)i;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            switch (column) {
+                case SIG_CATEGORY: return rows[a].category < rows[b].category;
+                case SIG_SEVERITY: return rows[a].severity < rows[b].severity;
+                case SIG_LAST_SEEN: return rows[a].last_seen < rows[b].last_seen;
+                case SIG_COUNT: return rows[a].count < rows[b].count;
+                default: return false; // rows already come sorted by name
+            }
+        });
+    }
+    return snapshot;
+}
+
+std::shared_ptr<const TopSnapshot> make_top_snapshot(int n) {
+    auto snapshot = std::make_shared<TopSnapshot>();
+    snapshot->time = (long long)std::time(0);
+    snapshot->sum = sum;
+    const std::map<std::string, long long>* totals[] = {&src_ip_total, &dest_ip_total, &country_total, &signature_total, &tag_total};
+    snapshot->tops[0] = top_ips(src_ip_total, src_ip_cold, n);
+    snapshot->tops[1] = top_ips(dest_ip_total, dest_ip_cold, n);
+    for (int i = 2; i < 5; i++) snapshot->tops[i] = top_n(*totals[i], n);
+    snapshot->entries = {
+        {"all_logs", all_logs.size()},
+        {"src_ip_total", src_ip_total.size()}, {"dest_ip_total", dest_ip_total.size()},
+        {"country_total", country_total.size()}, {"signature_total", signature_total.size()},
+        {"tag_total", tag_total.size()}, {"signature_info", signature_info.size()},
+        {"attacks_per_hour", attacks_per_hour.size()}, {"attacks_per_minute", attacks_per_minute.size()},
+        {"all_bar_hour", all_bar_hour.size()}, {"all_bar_minute", all_bar_minute.size()}
+    };
+    return snapshot;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include "core.hpp"
+
+// One row of the Signature Statistics table
+struct SignatureRow {
+    std::string signature;
+    std::string category;
+    int severity;
+    double last_seen;
+    long long count;
+};
+
+// Immutable copy of all signatures plus one ascending index permutation per sortable column
+struct SignatureSnapshot {
+    std::vector<SignatureRow> rows;
+    std::vector<int> order[5];
+};
+
+// Immutable, pre-sorted copy of one bucket shared with the Detail popup
+struct BarSnapshot {
+    double time;
+    bool hour;
+    long long attacks;
+    std::vector<sll> src_count, dest_count, signature_count, country_count, tag_count;
+};
+
+// Top-N lists and structure sizes, published by process_data for the metrics server
+struct TopSnapshot {
+    long long time;
+    long long sum;
+    std::vector<sll> tops[5];                                 // src_ip, dest_ip, country, signature, tag
+    std::vector<std::pair<const char*, size_t>> entries;      // Entries per aggregate
+};
+
+// Rebuilt by process_data when QUEUE_SNAPSHOT is queued to it, swapped atomically
+extern std::shared_ptr<const TopSnapshot> top_snapshot;
+extern std::atomic<int> top_snapshot_n;   // Entries per top-N list
+
+enum SignatureColumn { SIG_NAME, SIG_CATEGORY, SIG_SEVERITY, SIG_LAST_SEEN, SIG_COUNT };
+
+// Caller holds mtx
+std::shared_ptr<const BarSnapshot> make_bar_snapshot(const BarDetail &bar, double time, bool hour, long long attacks);
+// Reads the aggregates without mtx, only the aggregating thread may call it
+std::shared_ptr<const TopSnapshot> make_top_snapshot(int n);
+// Takes mtx only for the copy, the permutations are sorted after it is released
+std::shared_ptr<const SignatureSnapshot> make_signature_snapshot();
@@ -0,0 +1,136 @@
+#include "trace.hpp"
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <csignal>
+#include <iostream>
+
+std::atomic<bool> trace_enabled(false);
+
+static const uint64_t TRACE_BUFFER_SIZE = 1 << 16;   // Newest zones kept per thread
+
+// Fields are relaxed atomics so a dump can read a slot while its owner rewrites it
+struct TraceEvent {
+    std::atomic<const char*> name;
+    std::atomic<uint64_t> start, end;
+};
+
+struct TraceBuffer {
+    int tid;
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> head{0};   // Zones recorded so far, slot = head % TRACE_BUFFER_SIZE
+    TraceEvent events[TRACE_BUFFER_SIZE];
+};
+
+// Never destroyed: detached pipeline threads may still record while main returns
+static std::mutex &registry_mtx = *new std::mutex;
+static std::vector<TraceBuffer*> &buffers = *new std::vector<TraceBuffer*>;
+static std::mutex &dump_mtx = *new std::mutex;
+static std::string &trace_file = *new std::string;
+static std::atomic<bool> dump_requested(false);
+static uint64_t base_ticks = 0;
+
+static thread_local TraceBuffer* local_buffer = nullptr;
+static thread_local const char* local_name = nullptr;
+
+// Allocated on the first zone, so threads never traced cost nothing
+static TraceBuffer* thread_buffer() {
+    if (!local_buffer) {
+        local_buffer = new TraceBuffer();
+        local_buffer->name = local_name;
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        local_buffer->tid = (int)buffers.size() + 1;
+        buffers.push_back(local_buffer);
+    }
+    return local_buffer;
+}
+
+void trace_record(const char* name, uint64_t start, uint64_t end) {
+    TraceBuffer* buffer = thread_buffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer->events[head % TRACE_BUFFER_SIZE];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void trace_thread_name(const char* name) {
+    local_name = name;
+    if (local_buffer) local_buffer->name = name;
+}
+
+void trace_request_dump() {
+    dump_requested = true;
+}
+
+void trace_start(const std::string &filename) {
+    trace_file = filename;
+    base_ticks = ticks_now();
+    trace_enabled = true;
+
+    #ifndef _WIN32
+        signal(SIGUSR1, [](int) { trace_request_dump(); });
+    #endif
+
+    // Dumps requested by the signal handler or the GUI are written here, off their threads
+    std::thread([] {
+        while (1) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (dump_requested.exchange(false)) trace_dump();
+        }
+    }).detach();
+}
+
+bool trace_dump() {
+    std::lock_guard<std::mutex> dump_lock(dump_mtx);
+    std::vector<TraceBuffer*> threads;
+    {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        threads = buffers;
+    }
+
+    FILE* file = fopen(trace_file.c_str(), "w");
+    if (!file) {
+        std::cerr << "ERROR: cannot write trace to " << trace_file << std::endl;
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Log_Parser\"}}");
+    long long zones = 0;
+    for (TraceBuffer* buffer : threads) {
+        const char* name = buffer->name.load();
+        if (name) fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", buffer->tid, name);
+        else fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", buffer->tid, buffer->tid);
+
+        // Copy the ring, then drop the slots the owner may have rewritten meanwhile
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+        std::vector<const char*> names;
+        std::vector<uint64_t> starts, ends;
+        for (uint64_t i = first; i < head; i++) {
+            const TraceEvent &event = buffer->events[i % TRACE_BUFFER_SIZE];
+            names.push_back(event.name.load(std::memory_order_relaxed));
+            starts.push_back(event.start.load(std::memory_order_relaxed));
+            ends.push_back(event.end.load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now_head = buffer->head.load(std::memory_order_relaxed);
+        uint64_t valid = now_head >= TRACE_BUFFER_SIZE ? now_head - TRACE_BUFFER_SIZE + 1 : 0;
+
+        for (uint64_t i = std::max(first, valid); i < head; i++) {
+            size_t k = (size_t)(i - first);
+            if (starts[k] < base_ticks || ends[k] < starts[k]) continue;
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                    names[k], ticks_to_ns(starts[k] - base_ticks) / 1000.0, ticks_to_ns(ends[k] - starts[k]) / 1000.0, buffer->tid);
+            zones++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    std::cerr << "Trace: " << zones << " zones from " << threads.size() << " threads written to " << trace_file << std::endl;
+    return true;
+}
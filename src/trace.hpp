@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "metrics.hpp"
+
+// Timeline tracing for stalls: scoped zones are recorded per thread into a ring
+// buffer that only its own thread writes, and trace_dump writes them as Chrome
+// trace-event JSON (open in Perfetto or chrome://tracing). Off unless trace_start
+// was called, a disabled zone costs one relaxed load.
+
+extern std::atomic<bool> trace_enabled;
+
+// Starts recording. Dumps go to filename, on trace_request_dump and on SIGUSR1 (UNIX).
+void trace_start(const std::string &filename);
+// Name of the calling thread in the trace, must be a string literal
+void trace_thread_name(const char* name);
+// Asks the trace thread to write the newest zones of every thread, safe in a signal handler
+void trace_request_dump();
+// Writes the dump now on the calling thread
+bool trace_dump();
+
+// Zone [start, end] on the calling thread, name must be a string literal
+void trace_record(const char* name, uint64_t start, uint64_t end);
+
+class TraceZone {
+    private:
+        const char* name;
+        uint64_t start;
+
+    public:
+        explicit TraceZone(const char* name) : name(name), start(trace_enabled.load(std::memory_order_relaxed) ? ticks_now() : 0) {}
+        ~TraceZone() { if (start) trace_record(name, start, ticks_now()); }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+
+// lock_guard that records the wait for the mutex ("lock <name>") and how long
+// it was held ("hold <name>") as two zones
+class TracedLock {
+    private:
+        std::mutex &m;
+        const char* hold_name;
+        uint64_t held = 0;
+
+    public:
+        TracedLock(std::mutex &m, const char* wait_name = "lock mtx", const char* hold_name = "hold mtx") : m(m), hold_name(hold_name) {
+            uint64_t wait = trace_enabled.load(std::memory_order_relaxed) ? ticks_now() : 0;
+            m.lock();
+            if (wait) {
+                held = ticks_now();
+                trace_record(wait_name, wait, held);
+            }
+        }
+        ~TracedLock() {
+            m.unlock();
+            if (held) trace_record(hold_name, held, ticks_now());
+        }
+
+        TracedLock(const TracedLock&) = delete;
+        TracedLock &operator=(const TracedLock&) = delete;
+};
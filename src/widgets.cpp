@@ -0,0 +1,1101 @@
+#include "widgets.hpp"
+#include "core.hpp"
+#include "snapshot.hpp"
+#include "search.hpp"
+#include "query.hpp"
+#include "metrics.hpp"
+#include "replay.hpp"
+#include "trace.hpp"
+#include "memory.hpp"
+#include "segment.hpp"
+#include "executor.hpp"
+#include <climits>
+#include <cfloat>
+#include <cstdio>
+#include <ctime>
+#include "imgui.h"
+#include "implot.h"
+#include "implot_internal.h"
+
+// TopSrcIP
+void ShowTopSrcIP() {
+    TRACE_ZONE("ShowTopSrcIP");
+    // Re-ranked only when new data was aggregated, counts include collapsed IPs
+    static std::vector<sll> src_ips;
+    static unsigned long long version = ULLONG_MAX;
+    {
+        TracedLock lock(mtx);
+        if (src_ip_total.empty()) {
+            ImGui::Text("No data available.");
+            return;
+        }
+        if (version != data_version) {
+            version = data_version;
+            src_ips = top_ips(src_ip_total, src_ip_cold, 10);
+        }
+    }
+
+    int count = (src_ips.size() < 10) ? src_ips.size() : 10;
+    double max_val = (double)src_ips[0].second;
+    double x_attacks[10];
+    double y_ip[10];
+    const char* labels[10];
+
+    for (int i = 0; i < count; i++) {
+        int idx = count - 1 - i;
+        y_ip[i] = (double)i;
+        x_attacks[i] = (double)src_ips[idx].second;
+        labels[i] = src_ips[idx].first.c_str();
+    }
+
+    ImGui::Text("Top Source IP");
+    if (ImPlot::BeginPlot("TopSrcIP", ImVec2(-1, -1))) {
+        ImPlot::SetupAxes("Attacks", "IP Addr");
+        ImPlot::SetupAxisLimits(ImAxis_Y1, -0.5, count - 0.5, ImPlotCond_Always);
+        ImPlot::SetupAxisTicks(ImAxis_Y1, y_ip, count, labels);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, max_val * 1.2, ImPlotCond_Always);
+        ImPlot::PlotBars("##attacks", x_attacks, y_ip, count, 0.6f, ImPlotBarsFlags_Horizontal);
+        for (int i = 0; i < count; i++) {
+            char text[32];
+            snprintf(text, sizeof(text), "%lld", (long long)x_attacks[i]);
+            ImPlot::PlotText(text, x_attacks[i], y_ip[i], ImVec2(15, 0));
+        }
+        ImPlot::EndPlot();
+    }
+}
+
+// TopDestIP
+void ShowTopDestIP() {
+    TRACE_ZONE("ShowTopDestIP");
+    // Re-ranked only when new data was aggregated, counts include collapsed IPs
+    static std::vector<sll> dest_ips;
+    static unsigned long long version = ULLONG_MAX;
+    {
+        TracedLock lock(mtx);
+        if (dest_ip_total.empty()) {
+            ImGui::Text("No data available.");
+            return;
+        }
+        if (version != data_version) {
+            version = data_version;
+            dest_ips = top_ips(dest_ip_total, dest_ip_cold, 10);
+        }
+    }
+
+    int count = (dest_ips.size() < 10) ? dest_ips.size() : 10;
+    double max_val = (double)dest_ips[0].second;
+    double x_attacks[10];
+    double y_ip[10];
+    const char* labels[10];
+
+    for (int i = 0; i < count; i++) {
+        int idx = count - 1 - i;
+        y_ip[i] = (double)i;
+        x_attacks[i] = (double)dest_ips[idx].second;
+        labels[i] = dest_ips[idx].first.c_str(); 
+    }
+
+    ImGui::Text("Top Destination IP");
+    if (ImPlot::BeginPlot("TopDestIP", ImVec2(-1, -1))) {
+        ImPlot::SetupAxes("Attacks", "IP Addr");
+        ImPlot::SetupAxisLimits(ImAxis_Y1, -0.5, count - 0.5, ImPlotCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, max_val * 1.2, ImPlotCond_Always);
+        ImPlot::SetupAxisTicks(ImAxis_Y1, y_ip, count, labels);
+        ImPlot::PlotBars("##attacks", x_attacks, y_ip, count, 0.6f, ImPlotBarsFlags_Horizontal);
+        for (int i = 0; i < count; i++) {
+            char text[32];
+            snprintf(text, sizeof(text), "%lld", (long long)x_attacks[i]);
+            ImPlot::PlotText(text, x_attacks[i], y_ip[i], ImVec2(15, 0));
+        }
+        ImPlot::EndPlot();
+    }
+}
+
+// TopCountry
+void ShowTopCountry() {
+    TRACE_ZONE("ShowTopCountry");
+    // Re-sorted only when new data was aggregated
+    static std::vector<sll> countries;
+    static unsigned long long version = ULLONG_MAX;
+    bool changed = false;
+    {
+        TracedLock lock(mtx);
+        if (country_total.empty()) {
+            ImGui::Text("No data available.");
+            return;
+        }
+        if (version != data_version) {
+            version = data_version;
+            countries.assign(country_total.begin(), country_total.end());
+            changed = true;
+        }
+    }
+    if (changed) desc_sort(countries);
+
+    int count = (countries.size() < 10) ? countries.size() : 10;
+    double max_val = (double)countries[0].second;
+    double x_attacks[10];
+    double y_country[10];
+    const char* labels[10];
+
+    for (int i = 0; i < count; i++) {
+        int idx = count - 1 - i;
+        y_country[i] = (double)i;
+        x_attacks[i] = (double)countries[idx].second;
+        labels[i] = countries[idx].first.c_str(); 
+    }
+
+    ImGui::Text("Top Country");
+    if (ImPlot::BeginPlot("TopCountry", ImVec2(-1, -1))) {
+        ImPlot::SetupAxes("Attacks", "Country");
+        ImPlot::SetupAxisLimits(ImAxis_Y1, -0.5, count - 0.5, ImPlotCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, max_val * 1.2, ImPlotCond_Always);
+        ImPlot::SetupAxisTicks(ImAxis_Y1, y_country, count, labels);
+        ImPlot::PlotBars("##attacks", x_attacks, y_country, count, 0.6f, ImPlotBarsFlags_Horizontal);
+        for (int i = 0; i < count; i++) {
+            char text[32];
+            snprintf(text, sizeof(text), "%lld", (long long)x_attacks[i]);
+            ImPlot::PlotText(text, x_attacks[i], y_country[i], ImVec2(15, 0));
+        }
+        ImPlot::EndPlot();
+    }
+}
+
+// TopTag
+void ShowTopTag() {
+    TRACE_ZONE("ShowTopTag");
+    // Re-sorted only when new data was aggregated
+    static std::vector<sll> tags;
+    static unsigned long long version = ULLONG_MAX;
+    bool changed = false;
+    {
+        TracedLock lock(mtx);
+        if (tag_total.empty()) {
+            ImGui::Text("No data available.");
+            return;
+        }
+        if (version != data_version) {
+            version = data_version;
+            tags.assign(tag_total.begin(), tag_total.end());
+            changed = true;
+        }
+    }
+    if (changed) desc_sort(tags);
+
+    int count = (tags.size() < 10) ? tags.size() : 10;
+    double max_val = (double)tags[0].second;
+    double x_attacks[10];
+    double y_tag[10];
+    const char* labels[10];
+
+    for (int i = 0; i < count; i++) {
+        int idx = count - 1 - i;
+        y_tag[i] = (double)i;
+        x_attacks[i] = (double)tags[idx].second;
+        labels[i] = tags[idx].first.c_str();
+    }
+
+    ImGui::Text("Top Tag");
+    if (ImPlot::BeginPlot("TopTag", ImVec2(-1, -1))) {
+        ImPlot::SetupAxes("Attacks", "Tag");
+        ImPlot::SetupAxisLimits(ImAxis_Y1, -0.5, count - 0.5, ImPlotCond_Always);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, max_val * 1.2, ImPlotCond_Always);
+        ImPlot::SetupAxisTicks(ImAxis_Y1, y_tag, count, labels);
+        ImPlot::PlotBars("##attacks", x_attacks, y_tag, count, 0.6f, ImPlotBarsFlags_Horizontal);
+        for (int i = 0; i < count; i++) {
+            char text[32];
+            snprintf(text, sizeof(text), "%lld", (long long)x_attacks[i]);
+            ImPlot::PlotText(text, x_attacks[i], y_tag[i], ImVec2(15, 0));
+        }
+        ImPlot::EndPlot();
+    }
+}
+
+// SignatureTable
+void ShowSignatureTable() {
+    TRACE_ZONE("ShowSignatureTable");
+    // Rebuilt at most once a second, sorting only swaps which permutation is read
+    static std::shared_ptr<const SignatureSnapshot> snapshot;
+    static unsigned long long version = ULLONG_MAX;
+    static double last_build = 0;
+    static int sort_column = SIG_COUNT;
+    static bool ascending = false;
+
+    double current_time = ImGui::GetTime();
+    if (version != data_version && (current_time - last_build > 1.0 || !snapshot)) {
+        version = data_version;
+        last_build = current_time;
+        snapshot = make_signature_snapshot();
+    }
+    if (!snapshot || snapshot->rows.empty()) {
+        ImGui::Text("No data available.");
+        return;
+    }
+
+    ImGui::Text("Signature Statistics");
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable;
+    if (ImGui::BeginTable("SignatureTable", 5, flags, ImVec2(0, -1))) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Signature", ImGuiTableColumnFlags_WidthStretch, 0.0f, SIG_NAME);
+        ImGui::TableSetupColumn("Category", ImGuiTableColumnFlags_WidthStretch, 0.0f, SIG_CATEGORY);
+        ImGui::TableSetupColumn("Severity", ImGuiTableColumnFlags_WidthFixed, 70.0f, SIG_SEVERITY);
+        ImGui::TableSetupColumn("Last seen", ImGuiTableColumnFlags_WidthFixed, 150.0f, SIG_LAST_SEEN);
+        ImGui::TableSetupColumn("Attacks", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending, 100.0f, SIG_COUNT);
+        ImGui::TableHeadersRow();
+
+        ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs();
+        if (sort_specs && sort_specs->SpecsDirty) {
+            if (sort_specs->SpecsCount > 0) {
+                sort_column = (int)sort_specs->Specs[0].ColumnUserID;
+                ascending = sort_specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+            }
+            sort_specs->SpecsDirty = false;
+        }
+
+        const std::vector<SignatureRow> &rows = snapshot->rows;
+        const std::vector<int> &order = snapshot->order[sort_column];
+        int n = (int)rows.size();
+
+        ImGuiListClipper clipper;
+        clipper.Begin(n);
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const SignatureRow &row = rows[order[ascending ? i : n - 1 - i]];
+                char time_text[32];
+
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(row.signature.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextUnformatted(row.category.c_str());
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%d", row.severity);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::TextUnformatted(format_time_buf(time_text, sizeof(time_text), row.last_seen, true, true));
+                ImGui::TableSetColumnIndex(4);
+                ImGui::Text("%lld", row.count);
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+// ReplayControls
+void ShowReplayControls() {
+    TRACE_ZONE("ShowReplayControls");
+    static const double speeds[] = {1, 10, 100, 1000};
+    static double seek_value = 0;
+    static bool seeking = false;
+    double now = clock_now();
+    double speed = replay_speed();
+    bool paused = replay_paused();
+    char text[32];
+
+    ImGui::Text("Replay:");
+    ImGui::SameLine();
+    if (ImGui::Button(paused ? "Play" : "Pause", ImVec2(60, 0))) replay_set_paused(!paused);
+    ImGui::SameLine();
+    snprintf(text, sizeof(text), "%gx", speed);
+    ImGui::SetNextItemWidth(80);
+    if (ImGui::BeginCombo("##speed", text)) {
+        for (double s : speeds) {
+            snprintf(text, sizeof(text), "%gx", s);
+            if (ImGui::Selectable(text, s == speed)) replay_set_speed(s);
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+
+    // The slider follows the clock except while it is dragged
+    double first = replay_first_time(), end = std::max(replay_end_time(), now);
+    if (!seeking) seek_value = now;
+    ImGui::SetNextItemWidth(500);
+    ImGui::SliderScalar("##seek", ImGuiDataType_Double, &seek_value, &first, &end, "");
+    seeking = ImGui::IsItemActive();
+    if (ImGui::IsItemDeactivatedAfterEdit()) replay_seek(seek_value);
+    ImGui::SameLine();
+    ImGui::TextUnformatted(format_time_buf(text, sizeof(text), seeking ? seek_value : now, true, true));
+}
+
+// Pipeline
+static void LatencyRow(const char* name, const LatencyHistogram &h) {
+    ImGui::TableNextRow();
+    ImGui::TableSetColumnIndex(0);
+    ImGui::TextUnformatted(name);
+    ImGui::TableSetColumnIndex(1);
+    ImGui::Text("%llu", (unsigned long long)h.count());
+    ImGui::TableSetColumnIndex(2);
+    ImGui::Text("%.1f", h.percentile_ns(0.50) / 1000);
+    ImGui::TableSetColumnIndex(3);
+    ImGui::Text("%.1f", h.percentile_ns(0.99) / 1000);
+    ImGui::TableSetColumnIndex(4);
+    ImGui::Text("%.1f", h.percentile_ns(0.999) / 1000);
+    ImGui::TableSetColumnIndex(5);
+    ImGui::Text("%.1f", h.max_ns() / 1000);
+}
+
+void ShowPipeline() {
+    TRACE_ZONE("ShowPipeline");
+    // Reads the atomics directly so the tab stays allocation-free
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+    ImGui::Text("Stages (service time per event, per frame for render)");
+    if (ImGui::BeginTable("StageTable", 7, flags)) {
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("In");
+        ImGui::TableSetupColumn("Out");
+        ImGui::TableSetupColumn("Busy %");
+        ImGui::TableSetupColumn("p50 (us)");
+        ImGui::TableSetupColumn("p99 (us)");
+        ImGui::TableSetupColumn("Max (us)");
+        ImGui::TableHeadersRow();
+        for (const auto &stage : stage_metrics) {
+            unsigned long long busy = stage.busy_ticks, idle = stage.idle_ticks;
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(stage.name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%llu", (unsigned long long)stage.in);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%llu", (unsigned long long)stage.out);
+            ImGui::TableSetColumnIndex(3);
+            ImGui::Text("%.1f", busy + idle ? 100.0 * busy / (busy + idle) : 0.0);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::Text("%.1f", stage.service.percentile_ns(0.50) / 1000);
+            ImGui::TableSetColumnIndex(5);
+            ImGui::Text("%.1f", stage.service.percentile_ns(0.99) / 1000);
+            ImGui::TableSetColumnIndex(6);
+            ImGui::Text("%.1f", stage.service.max_ns() / 1000);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Text("Queues: read %zu, parsed %zu", read_queue.size(), parsed_queue.size());
+
+    ImGui::Text("End-to-end latency");
+    if (ImGui::BeginTable("LatencyTable", 6, flags)) {
+        ImGui::TableSetupColumn("Path");
+        ImGui::TableSetupColumn("Events");
+        ImGui::TableSetupColumn("p50 (us)");
+        ImGui::TableSetupColumn("p99 (us)");
+        ImGui::TableSetupColumn("p99.9 (us)");
+        ImGui::TableSetupColumn("Max (us)");
+        ImGui::TableHeadersRow();
+        LatencyRow("Read -> aggregated", read_to_aggregated);
+        LatencyRow("Read -> visible", read_to_visible);
+        ImGui::EndTable();
+    }
+
+    long long budget = memory_budget;
+    ImGui::Text("Memory: %.1f MB", memory_total() / 1048576.0);
+    ImGui::SameLine();
+    if (budget > 0) ImGui::Text("of %.1f MB budget | Evicted: %lld minute, %lld hour buckets, %lld cold IPs",
+                                budget / 1048576.0, (long long)evicted_minute_buckets, (long long)evicted_hour_buckets, (long long)collapsed_ips);
+    else ImGui::TextUnformatted("(no budget)");
+    if (ImGui::BeginTable("MemoryTable", 3, flags)) {
+        ImGui::TableSetupColumn("Structure");
+        ImGui::TableSetupColumn("Entries");
+        ImGui::TableSetupColumn("MB");
+        ImGui::TableHeadersRow();
+        for (const auto &stat : memory_stats) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::TextUnformatted(stat.name);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%lld", (long long)stat.entries);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::Text("%.2f", stat.bytes / 1048576.0);
+        }
+        ImGui::EndTable();
+    }
+}
+
+struct TimeState {
+    int year_idx = 10;
+    int month_idx = 0;
+    int day_idx = 0;
+    int hour_idx = 0;
+    int minute_idx = 0;
+};
+
+const char* years[] = {
+    "2015","2016", "2017", "2018", "2019", "2020",
+    "2021", "2022", "2023", "2024", "2025", "2026",
+    "2027", "2028", "2029", "2030", "2031", "2032",
+    "2033", "2034", "2035", "2036", "2037", "2038",
+    "2039", "2040", "2041", "2042", "2043", "2044",
+    "2045", "2046", "2047", "2048", "2049", "2050"
+};
+const char* months[] = {
+    "01", "02", "03", "04", "05", "06",
+    "07", "08", "09", "10", "11", "12"
+};
+const char* days[] = {
+    "01", "02", "03", "04", "05", "06", "07", "08", "09", "10",
+    "11", "12", "13", "14", "15", "16", "17", "18", "19", "20",
+    "21", "22", "23", "24", "25", "26", "27", "28", "29", "30", "31"
+};
+const char* hours[] = {
+    "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "10", "11",
+    "12", "13", "14", "15", "16", "17", "18", "19", "20", "21", "22", "23"
+};
+const char* minutes[] = {
+    "00", "01", "02", "03", "04", "05", "06", "07", "08", "09", "10", "11",
+    "12", "13", "14", "15", "16", "17", "18", "19", "20", "21", "22", "23",
+    "24", "25", "26", "27", "28", "29", "30", "31", "32", "33", "34", "35",
+    "36", "37", "38", "39", "40", "41", "42", "43", "44", "45", "46", "47",
+    "48", "49", "50", "51", "52", "53", "54", "55", "56", "57", "58", "59"
+};
+
+// TimePicker
+static void TimePicker(const char* label, TimeState &state, char *out, size_t size) {
+    ImGui::PushID(label);
+
+    ImGuiComboFlags flags = ImGuiComboFlags_NoArrowButton | ImGuiComboFlags_WidthFitPreview;
+
+    const char* hour = hours[state.hour_idx];
+    if (ImGui::BeginCombo("##hour", hour, flags)) {
+        for (int i = 0; i < 24; i++) {
+            if (ImGui::Selectable(hours[i], state.hour_idx == i)) {
+                state.hour_idx = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text(":");
+    ImGui::SameLine();
+
+    const char* minute = minutes[state.minute_idx];
+    if (ImGui::BeginCombo("##minute", minute, flags)) {
+        for (int i = 0; i < 60; i++) {
+            if (ImGui::Selectable(minutes[i], state.minute_idx == i)) {
+                state.minute_idx = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+
+    const char* day = days[state.day_idx];
+    if (ImGui::BeginCombo("##day", day, flags)) {
+        for (int i = 0; i < 31; i++) {
+            if (ImGui::Selectable(days[i], state.day_idx == i)) {
+                state.day_idx = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text("/");
+    ImGui::SameLine();
+
+    const char* month = months[state.month_idx];
+    if (ImGui::BeginCombo("##month", month, flags)) {
+        for (int i = 0; i < 12; i++) {
+            if (ImGui::Selectable(months[i], state.month_idx == i)) {
+                state.month_idx = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text("/");
+    ImGui::SameLine();
+
+    const char* year = years[state.year_idx];
+    if (ImGui::BeginCombo("##year", year, flags)) {
+        for (int i = 0; i < 36; i++) {
+            if (ImGui::Selectable(years[i], state.year_idx == i)) {
+                state.year_idx = i;
+            }
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::PopID();
+
+    snprintf(out, size, "%s-%s-%sT%s:%s", year, month, day, hour, minute);
+}
+
+void PlotColormapBars(const char* label, const std::vector<double> &x, const std::vector<double> &y, double width, double color_max) {
+    if (x.empty()) return;
+    if (ImPlot::FitThisFrame()) {
+        ImPlot::FitPoint(ImPlotPoint(x.front() - width / 2, 0));
+        ImPlot::FitPoint(ImPlotPoint(x.back() + width / 2, *std::max_element(y.begin(), y.end())));
+    }
+    if (!ImPlot::BeginItem(label)) return;
+
+    ImPlotRange visible = ImPlot::GetPlotLimits().X;
+    size_t first = std::lower_bound(x.begin(), x.end(), visible.Min - width / 2) - x.begin();
+    size_t last = std::upper_bound(x.begin(), x.end(), visible.Max + width / 2) - x.begin();
+
+    ImDrawList* draw_list = ImPlot::GetPlotDrawList();
+    float base = ImPlot::PlotToPixels(x.front(), 0).y;
+    auto draw_bar = [&](float left, float right, double top) {
+        float t = (float)(top / color_max);
+        if (t > 1.0f) t = 1.0f;
+        if (right - left < 1.0f) right = left + 1.0f;
+        ImU32 color = ImGui::ColorConvertFloat4ToU32(ImPlot::SampleColormap(t));
+        draw_list->AddRectFilled(ImVec2(left, ImPlot::PlotToPixels(x.front(), top).y), ImVec2(right, base), color);
+    };
+
+    int column = INT_MIN;
+    float left = 0, right = 0;
+    double top = 0;
+    for (size_t i = first; i < last; i++) {
+        float l = ImPlot::PlotToPixels(x[i] - width / 2, 0).x;
+        float r = ImPlot::PlotToPixels(x[i] + width / 2, 0).x;
+        int c = (int)((l + r) / 2);
+        if (c == column) {
+            right = std::max(right, r);
+            top = std::max(top, y[i]);
+            continue;
+        }
+        if (column != INT_MIN) draw_bar(left, right, top);
+        column = c;
+        left = l;
+        right = r;
+        top = y[i];
+    }
+    if (column != INT_MIN) draw_bar(left, right, top);
+
+    ImPlot::EndItem();
+}
+
+int FindBar(const std::vector<double> &x, double width, double mouse_x) {
+    auto it = std::lower_bound(x.begin(), x.end(), mouse_x - width / 2);
+    if (it == x.end() || *it > mouse_x + width / 2) return -1;
+    return (int)(it - x.begin());
+}
+
+// One tab of the Detail popup, only visible rows are emitted
+static void ShowDetailTable(const char* id, const char* name, const std::vector<sll> &rows) {
+    if (ImGui::BeginTable(id, 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImVec2(0, -1))) {
+        ImGui::TableSetupColumn(name, ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Numbers", ImGuiTableColumnFlags_WidthFixed, 100.0f);
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin(rows.size());
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(rows[i].first.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%lld", rows[i].second);
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+// AttackTrend
+// Time filter, also set from outside through SetTrendRange
+static bool trend_filter = false, trend_live = true;
+static double trend_min, trend_max;
+
+void SetTrendRange(double from, double to) {
+    trend_filter = true;
+    trend_live = false;
+    trend_min = from;
+    trend_max = to;
+}
+
+// Series of the plot, rebuilt on the executor when new data was aggregated
+struct TrendSeries {
+    std::vector<double> x_hour, y_hour;
+    std::vector<double> x_minute, y_minute;
+    double max_val_hour = 0, max_val_minute = 0;
+};
+
+// Never destroyed: a rebuild may still be running when main returns
+static std::mutex &trend_series_mtx = *new std::mutex;
+static std::shared_ptr<const TrendSeries> &trend_series_built = *new std::shared_ptr<const TrendSeries>;   // Guarded by trend_series_mtx
+static std::atomic<bool> trend_rebuilding(false);
+
+static void rebuild_trend_series() {
+    TRACE_ZONE("rebuild trend");
+    auto series = std::make_shared<TrendSeries>();
+    {
+        TracedLock lock(mtx);
+        for (const auto &a : attacks_per_hour) {
+            series->x_hour.push_back(a.first);
+            series->y_hour.push_back((double)a.second);
+            if (a.second > series->max_val_hour) series->max_val_hour = a.second;
+        }
+        for (const auto &a : attacks_per_minute) {
+            series->x_minute.push_back(a.first);
+            series->y_minute.push_back((double)a.second);
+            if (a.second > series->max_val_minute) series->max_val_minute = a.second;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(trend_series_mtx);
+        trend_series_built = series;
+        trend_rebuilding = false;
+    }
+    view_version++;
+    wake_renderer();
+}
+
+bool AttackTrendPending() {
+    std::lock_guard<std::mutex> lock(trend_series_mtx);
+    return trend_rebuilding || trend_series_built;
+}
+
+void ShowAttackTrend() {
+    TRACE_ZONE("ShowAttackTrend");
+    // One rebuild at a time, the plot keeps the previous series until it lands
+    static std::shared_ptr<const TrendSeries> series = std::make_shared<TrendSeries>();
+    static unsigned long long version = ULLONG_MAX;
+    if (version != data_version && !trend_rebuilding.exchange(true)) {
+        version = data_version;
+        executor_run(rebuild_trend_series);
+    }
+    {
+        std::lock_guard<std::mutex> lock(trend_series_mtx);
+        if (trend_series_built) series = std::move(trend_series_built);
+    }
+
+    // Time filter
+    double now = clock_now();
+
+    ImGui::Text("Time filter:");
+    ImGui::SameLine();
+
+    if (trend_live) {
+        ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.0f, 0.0f, 1.0f));
+        if (ImGui::Button("LIVE")) trend_live = false;
+        ImGui::PopStyleColor();
+    }
+    else {
+        if (ImGui::Button("LIVE")) trend_live = true;
+    }
+
+    ImGui::SameLine();
+    ImGui::Text("|");
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+
+    if (ImGui::Button("Hours")) {
+        ImGui::OpenPopup("menu_hours");
+    }
+    if (ImGui::BeginPopup("menu_hours")) {
+        for (int i = 1; i <= 3; i++) {
+            if (ImGui::Selectable(("Last " + std::to_string(i) + " hour" + (i > 1 ? "s" : "")).c_str())) {
+                trend_filter = true;
+                trend_live = false;
+                trend_min = now - i * 3600;
+                trend_max = now;
+            }
+        }
+        ImGui::EndPopup();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+
+    if (ImGui::Button("Days")) {
+        ImGui::OpenPopup("menu_days");
+    }
+    if (ImGui::BeginPopup("menu_days")) {
+        for (int i = 1; i <= 3; i++) {
+            if (ImGui::Selectable(("Last " + std::to_string(i) + " day" + (i > 1 ? "s" : "")).c_str())) {
+                trend_filter = true;
+                trend_live = false;
+                trend_min = now - i * 86400;
+                trend_max = now;
+            }
+        }
+        ImGui::EndPopup();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+
+    if (ImGui::Button("Weeks")) {
+        ImGui::OpenPopup("menu_weeks");
+    }
+    if (ImGui::BeginPopup("menu_weeks")) {
+        for (int i = 1; i <= 3; i++) {
+            if (ImGui::Selectable(("Last " + std::to_string(i) + " week" + (i > 1 ? "s" : "")).c_str())) {
+                trend_filter = true;
+                trend_live = false;
+                trend_min = now - i * 604800;
+                trend_max = now;
+            }
+        }
+        ImGui::EndPopup();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+
+    if (ImGui::Button("Months")) {
+        ImGui::OpenPopup("menu_months");
+    }
+    if (ImGui::BeginPopup("menu_months")) {
+        for (int i = 1; i <= 3; i++) {
+            if (ImGui::Selectable(("Last " + std::to_string(i) + " month" + (i > 1 ? "s" : "")).c_str())) {
+                trend_filter = true;
+                trend_live = false;
+                trend_min = now - i * 2592000;
+                trend_max = now;
+            }
+        }
+        ImGui::EndPopup();
+    }
+
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+
+    if (ImGui::Button("Years")) {
+        ImGui::OpenPopup("menu_years");
+    }
+    if (ImGui::BeginPopup("menu_years")) {
+        for (int i = 1; i <= 3; i++) {
+            if (ImGui::Selectable(("Last " + std::to_string(i) + " year" + (i > 1 ? "s" : "")).c_str())) {
+                trend_filter = true;
+                trend_live = false;
+                trend_min = now - i * 31536000;
+                trend_max = now;
+            }
+        }
+        ImGui::EndPopup();
+    }
+
+    // Advance filter
+    char from[32], to[32];
+    static bool input_error = false;
+    static TimeState from_state, to_state;
+    ImGui::Text("Advance:");
+    ImGui::SameLine();
+    ImGui::Text(" ");
+    ImGui::SameLine();
+    TimePicker("from", from_state, from, sizeof(from));
+    ImGui::SameLine();
+    ImGui::Text(" => ");
+    ImGui::SameLine();
+    TimePicker("to", to_state, to, sizeof(to));
+    ImGui::SameLine();
+
+    if (ImGui::Button("Apply")) {
+        std::string from_text(from), to_text(to);
+        double t1 = parse_timestamp(from_text, true);
+        double t2 = parse_timestamp(to_text, true);
+        if (t1 == -1 || t2 == -1 || t1 > t2) {
+            input_error = true;
+        }
+        else {
+            trend_filter = true;
+            trend_live = false;
+            input_error = false;
+            trend_min = t1;
+            trend_max = t2;
+        }
+    }
+
+    if (input_error) {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1, 0, 0, 1), "ERROR: Wrong time input");
+    }
+
+    static bool show_hour = true;
+
+    // Variable for bar detail
+    static std::shared_ptr<const BarSnapshot> selected_bar;
+    static unsigned long long selected_version = 0;
+    static bool open_popup = false;
+
+    // Threshold for colormap & slider
+    static int color_threshold = 100;
+    ImGui::Text("Color threshold:");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(500);
+    ImGui::SliderInt("##threshold", &color_threshold, 10, 5000);
+    ImGui::SameLine();
+
+    // Draw graph
+    ImGui::Text("Attack Trend");
+    ImPlot::GetStyle().Use24HourClock = true;
+    if (ImPlot::BeginPlot("AttackTrend", ImVec2(ImGui::GetContentRegionAvail().x - 68, -1))) {
+        ImPlot::SetupAxes("Time", "Attacks");
+        ImPlot::SetupAxisScale(ImAxis_X1, ImPlotScale_Time);
+
+        if (trend_live) ImPlot::SetupAxisLimits(ImAxis_X1, now - 1800, now, ImPlotCond_Always);
+        else if (trend_filter) {
+            ImPlot::SetupAxisLimits(ImAxis_X1, trend_min, trend_max, ImPlotCond_Always);
+            trend_filter = false;
+        }
+
+        if (show_hour) ImPlot::SetupAxisLimits(ImAxis_Y1, 0, series->max_val_hour * 1.2, ImPlotCond_Always);
+        else ImPlot::SetupAxisLimits(ImAxis_Y1, 0, series->max_val_minute * 1.2, ImPlotCond_Always);
+
+        show_hour = (ImPlot::GetPlotLimits().X.Size() >= 86400);
+
+        const std::vector<double> &x = show_hour ? series->x_hour : series->x_minute;
+        const std::vector<double> &y = show_hour ? series->y_hour : series->y_minute;
+        double width = show_hour ? 3600 : 60;
+
+        if (!x.empty()) {
+            ImPlot::PushColormap(ImPlotColormap_Jet);
+            PlotColormapBars("##attacks", x, y, width, (double)color_threshold);
+            ImGui::SameLine();
+            ImPlot::ColormapScale("##scale", 0, (double)color_threshold, ImVec2(60, -1));
+            ImPlot::PopColormap();
+        }
+
+        // Hover
+        if (ImPlot::IsPlotHovered()) {
+            ImPlotPoint mouse = ImPlot::GetPlotMousePos();
+            int i = FindBar(x, width, mouse.x);
+            if (i != -1) {
+                ImPlot::PushStyleColor(ImPlotCol_Fill, ImVec4(0.2f, 0.2f, 0.2f, 1.0f));
+                ImPlot::PlotBars("##hover", &x[i], &y[i], 1, width);
+                ImPlot::PopStyleColor();
+
+                char time_text[32];
+                ImGui::BeginTooltip();
+                ImGui::Text("Time: %s", format_time_buf(time_text, sizeof(time_text), x[i], !show_hour));
+                ImGui::Text("Attacks: %lld", (long long)y[i]);
+                ImGui::EndTooltip();
+
+                // Click
+                if (ImGui::IsMouseClicked(0)) {
+                    // Reopening an unchanged bar reuses the snapshot it already has
+                    if (!selected_bar || selected_bar->time != x[i] || selected_bar->hour != show_hour || selected_version != data_version) {
+                        TracedLock lock(mtx);
+                        // The detail of an old bucket may have been evicted by the memory budget
+                        static const BarDetail evicted;
+                        std::map<double, BarDetail> &all_bar = show_hour ? all_bar_hour : all_bar_minute;
+                        auto bar = all_bar.find(x[i]);
+                        selected_bar = make_bar_snapshot(bar != all_bar.end() ? bar->second : evicted, x[i], show_hour, (long long)y[i]);
+                        selected_version = data_version;
+                    }
+                    open_popup = true;
+                }
+            }
+        }
+        ImPlot::EndPlot();
+    }
+
+    if (open_popup) {
+        ImGui::OpenPopup("Detail");
+        open_popup = false;
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(600, 450), ImGuiCond_Appearing);
+    if (ImGui::BeginPopupModal("Detail", NULL, ImGuiWindowFlags_NoResize)) {
+        // Keep a reference so the snapshot outlives a click on another bar this frame
+        std::shared_ptr<const BarSnapshot> bar = selected_bar;
+        char time_text[32];
+        ImGui::Text("Time: %s", format_time_buf(time_text, sizeof(time_text), bar->time, !bar->hour));
+        ImGui::SameLine();
+        ImGui::Text("|");
+        ImGui::SameLine();
+        ImGui::Text("Total attacks: %lld", bar->attacks);
+        ImGui::Separator();
+
+        if (ImGui::BeginTabBar("Tabs")) {
+            if (ImGui::BeginTabItem("Attackers")) {
+                ImGui::Text("All attackers:");
+                ShowDetailTable("SrcTable", "IP", bar->src_count);
+                ImGui::EndTabItem();
+            }
+
+            if (ImGui::BeginTabItem("Victims")) {
+                ImGui::Text("All victims:");
+                ShowDetailTable("DestTable", "IP", bar->dest_count);
+                ImGui::EndTabItem();
+            }
+
+            if (ImGui::BeginTabItem("Signatures")) {
+                ImGui::Text("All type of attacks:");
+                ShowDetailTable("CateTable", "Signature", bar->signature_count);
+                ImGui::EndTabItem();
+            }
+
+            if (ImGui::BeginTabItem("Countries")) {
+                ImGui::Text("All attacked countries:");
+                ShowDetailTable("CounTable", "Country", bar->country_count);
+                ImGui::EndTabItem();
+            }
+
+            if (ImGui::BeginTabItem("Tags")) {
+                ImGui::Text("All matched tags:");
+                ShowDetailTable("TagTable", "Tag", bar->tag_count);
+                ImGui::EndTabItem();
+            }
+            ImGui::EndTabBar();
+        }
+
+        if (ImGui::Button("Close", ImVec2(150, 0))) ImGui::CloseCurrentPopup();
+        
+        ImGui::EndPopup();
+    }
+}
+
+// LogTable
+static ImGuiTextFilter log_filter;
+static const size_t MAX_HISTORY_ROWS = 8000;   // Rows shown by a history search
+
+void SetLogFilter(const char* text) {
+    snprintf(log_filter.InputBuf, sizeof(log_filter.InputBuf), "%s", text);
+    log_filter.Build();
+}
+
+void ShowLogTable() {
+    TRACE_ZONE("ShowLogTable");
+    static std::vector<LogInfo> display_logs;
+    static unsigned long long display_first = 0; // Log number of display_logs[0]
+    static double last_update_time = 0.0;
+    double current_time = ImGui::GetTime();
+    if (current_time - last_update_time > 5.0 || display_logs.empty()) {
+        TracedLock lock(mtx);
+        if (display_first + display_logs.size() != log_seq) {
+            display_logs.assign(all_logs.begin(), all_logs.end());
+            display_first = log_seq - all_logs.size();
+        }
+        last_update_time = current_time;
+    }
+
+    // Filter, matches are kept as log numbers and only new rows are tested
+    // A structured query replaces the substring terms when the text looks like one
+    static SearchTerms terms;
+    static std::shared_ptr<const Query> query;
+    static std::string query_error;
+    static std::vector<unsigned long long> matched;
+    static unsigned long long tested_end = 0;
+    static std::string filter_text;
+    if (filter_text != log_filter.InputBuf) {
+        filter_text = log_filter.InputBuf;
+        terms = parse_search_terms(log_filter.InputBuf);
+        query.reset();
+        query_error.clear();
+        if (looks_like_query(log_filter.InputBuf)) query = compile_query(filter_text, query_error);
+        matched.clear();
+        tested_end = 0;
+    }
+    // New signatures and the clock move what category, severity and now-1h resolved to
+    else if (query && query_outdated(*query, 1.0)) {
+        query = compile_query(filter_text, query_error);
+        matched.clear();
+        tested_end = 0;
+    }
+
+    bool is_filter = log_filter.IsActive();
+    if (is_filter) {
+        matched.erase(matched.begin(), std::lower_bound(matched.begin(), matched.end(), display_first));
+        unsigned long long display_end = display_first + display_logs.size();
+        for (unsigned long long seq = std::max(tested_end, display_first); seq < display_end; seq++) {
+            const LogInfo &log = display_logs[seq - display_first];
+            if (query ? query_matches(*query, log) : query_error.empty() && pass_search(terms, log)) matched.push_back(seq);
+        }
+        tested_end = display_end;
+    }
+    int row_count = is_filter ? (int)matched.size() : (int)display_logs.size();
+
+    // History: the same filter over every stored segment, newest matches first. It runs on
+    // the executor: a new filter cancels the running search and shows matches as they come,
+    // a refresh keeps the previous matches until the next search is done.
+    static bool history = false;
+    static std::shared_ptr<SearchTask> history_task;
+    static std::shared_ptr<const std::vector<LogInfo>> history_logs = std::make_shared<const std::vector<LogInfo>>();
+    static std::string history_filter;
+    static double history_time = 0;
+    static bool history_refresh = false;
+    bool new_filter = history_filter != log_filter.InputBuf;
+    bool refresh_due = current_time - history_time > 5.0 && (!history_task || history_task->done());
+    if (history && segment_store && (new_filter || refresh_due)) {
+        history_filter = log_filter.InputBuf;
+        history_time = current_time;
+        history_refresh = !new_filter;
+        if (history_task) history_task->cancel();
+        history_task.reset();
+        if (query) {
+            std::shared_ptr<const Query> q = query;
+            history_task = SearchTask::submit(*segment_store, [q](const Segment &segment, size_t limit, double threshold) {
+                return query_segment_logs(*q, segment, limit, threshold);
+            }, [q](const LogInfo &info) { return query_matches(*q, info); }, MAX_HISTORY_ROWS);
+        }
+        else if (query_error.empty()) {
+            SearchTerms t = terms;
+            history_task = SearchTask::submit(*segment_store, [t](const Segment &segment, size_t limit, double threshold) {
+                return search_segment(segment, t, 0, DBL_MAX, limit, threshold);
+            }, [t](const LogInfo &info) { return pass_search(t, info); }, MAX_HISTORY_ROWS);
+        }
+        if (!history_refresh) history_logs = std::make_shared<const std::vector<LogInfo>>();
+    }
+    if (history_task && (!history_refresh || history_task->done())) history_logs = history_task->results();
+    bool show_history = history && segment_store;
+    if (show_history) row_count = (int)history_logs->size();
+
+    // Draw table
+    ImGui::Text("Update Log Table after: %.1f seconds", 5.0 - (current_time - (show_history ? history_time : last_update_time)));
+    log_filter.Draw("Filter");
+    if (segment_store) {
+        ImGui::SameLine();
+        ImGui::Checkbox("Search history", &history);
+    }
+    if (!query_error.empty()) ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "Query: %s", query_error.c_str());
+    else if (show_history) {
+        ImGui::TextColored(ImVec4(1, 1, 0, 1), "Matched: %d (newest %zu) in %lld stored alerts", row_count, MAX_HISTORY_ROWS, segment_store->row_count());
+        if (history_task && !history_task->done() && !history_refresh) {
+            ImGui::SameLine();
+            ImGui::ProgressBar(history_task->progress(), ImVec2(150, 0));
+        }
+    }
+    else ImGui::TextColored(ImVec4(1, 1, 0, 1), "Matched: %d / %d", row_count, (int)display_logs.size());
+    if (ImGui::BeginTable("LogTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY, ImGui::GetContentRegionAvail())) {
+        ImGui::TableSetupColumn("Time");
+        ImGui::TableSetupColumn("Source IP Addr");
+        ImGui::TableSetupColumn("Destination IP Addr");
+        ImGui::TableSetupColumn("Country");
+        ImGui::TableSetupColumn("Signature");
+        ImGui::TableSetupColumn("Tags");
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin(row_count);
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                // Newest first
+                const LogInfo* log = show_history ? &(*history_logs)[i]
+                                   : is_filter ? &display_logs[matched[row_count - 1 - i] - display_first] : &display_logs[row_count - 1 - i];
+
+                ImGui::TableNextRow();
+
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(log->time_text);
+
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextUnformatted(log->src_ip.c_str());
+
+                ImGui::TableSetColumnIndex(2);
+                ImGui::TextUnformatted(log->dest_ip.c_str());
+
+                ImGui::TableSetColumnIndex(3);
+                ImGui::TextUnformatted(log->country.c_str());
+
+                ImGui::TableSetColumnIndex(4);
+                ImGui::TextUnformatted(log->signature.c_str());
+
+                ImGui::TableSetColumnIndex(5);
+                ImGui::TextUnformatted(log->tags.c_str());
+            }
+        }
+        ImGui::EndTable();
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+// Dashboard widgets, each reads the aggregates in core.hpp under mtx
+void ShowTopSrcIP();
+void ShowTopDestIP();
+void ShowTopCountry();
+void ShowTopTag();
+void ShowSignatureTable();
+void ShowAttackTrend();
+void ShowLogTable();
+// Used by the frame benchmark to drive the widgets without input
+void SetTrendRange(double from, double to);   // Leaves LIVE and shows [from, to]
+bool AttackTrendPending();                    // A series rebuild has not been drawn yet
+void SetLogFilter(const char* text);
+
+// Pause, speed and seek for --replay
+void ShowReplayControls();
+// Stage counters and latency histograms from metrics.hpp, no lock taken
+void ShowPipeline();
+
+// Draws every bar of a time-sorted series as one plot item, each bar coloured by
+// y / color_max through the current colormap. Bars outside the visible X range are
+// skipped and bars falling in the same pixel column are merged (tallest wins).
+void PlotColormapBars(const char* label, const std::vector<double> &x, const std::vector<double> &y, double width, double color_max);
+
+// Index of the bar of a time-sorted series under plot position mouse_x, or -1.
+// Shared by hover and click so both stay O(log n) in the history length.
+int FindBar(const std::vector<double> &x, double width, double mouse_x);
@@ -0,0 +1,314 @@
+#include "core.hpp"
+#include "query.hpp"
+#include "search.hpp"
+#include "segment.hpp"
+#include "checkpoint.hpp"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cfloat>
+#include <cstdio>
+#include <cstdint>
+
+// Checks run by ctest, one group per test: ./tests parser|segments|checkpoint
+
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(bool ok, const char* text, const char* file, int line) {
+    if (ok) return;
+    std::cerr << file << ":" << line << ": failed: " << text << std::endl;
+    failures++;
+}
+
+// Empty directory under the system temp dir, one per group so ctest -j can run them together
+static std::string temp_dir(const std::string &name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / ("log_parser_test_" + name);
+    std::error_code ec;
+    std::filesystem::remove_all(path, ec);
+    std::filesystem::create_directories(path, ec);
+    return path.string();
+}
+
+// Deterministic pseudo-random rows, spread over about a day
+static const double BASE_TIME = 1792000800;   // 2026-10-14T18:00:00
+static const char* SRC_IPS[] = {"10.0.0.1", "10.0.0.2", "10.1.2.3", "172.16.5.4", "192.168.1.7", "8.8.8.8", "2001:db8::1"};
+static const char* DEST_IPS[] = {"192.168.1.7", "192.168.1.8", "10.0.0.1", "1.1.1.1", "2001:db8::2"};
+static const char* COUNTRIES[] = {"Germany", "France", "United States", "Unknown"};
+static const char* SIGNATURES[] = {"ET SCAN Nmap", "ET POLICY Dropbox Client Broadcasting", "GPL ICMP PING", "ET EXPLOIT Test"};
+static const char* CATEGORIES[] = {"Attempted Recon", "Potential Corporate Privacy Violation", "Misc activity", "Attempted Admin"};
+static const int SEVERITIES[] = {2, 1, 3, 1};
+static const char* TAGS[] = {"", "dmz", "dmz, vpn", "vpn"};
+
+template <size_t N> static const char* pick(const char* const (&values)[N], uint32_t &state) {
+    state = state * 1664525 + 1013904223;
+    return values[(state >> 16) % N];
+}
+
+static LogInfo make_row(double time, uint32_t &state) {
+    LogInfo info;
+    info.timestamp = time;
+    info.src_ip = pick(SRC_IPS, state);
+    info.dest_ip = pick(DEST_IPS, state);
+    info.country = pick(COUNTRIES, state);
+    info.signature = pick(SIGNATURES, state);
+    info.tags = pick(TAGS, state);
+    fill_log_text(info);
+    return info;
+}
+
+// Enriched alert as parse_data hands it to aggregate_event, second of the day
+static nlohmann::json make_alert(int second, uint32_t &state) {
+    char timestamp[32];
+    snprintf(timestamp, sizeof(timestamp), "2026-10-14T%02d:%02d:%02d.000000+0000", second / 3600, second / 60 % 60, second % 60);
+    const char* signature = pick(SIGNATURES, state);
+    size_t index = 0;
+    while (SIGNATURES[index] != signature) index++;
+    std::vector<std::string> tags;
+    std::string tag = pick(TAGS, state);
+    if (!tag.empty()) tags.push_back(tag);
+    return {
+        {"src_ip", pick(SRC_IPS, state)},
+        {"dest_ip", pick(DEST_IPS, state)},
+        {"signature", signature},
+        {"category", CATEGORIES[index]},
+        {"severity", SEVERITIES[index]},
+        {"timestamp", timestamp},
+        {"country", pick(COUNTRIES, state)},
+        {"tags", tags}
+    };
+}
+
+static void add_signature_info() {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < 4; i++) {
+        SignatureInfo &info = signature_info[SIGNATURES[i]];
+        info.category = CATEGORIES[i];
+        info.severity = SEVERITIES[i];
+    }
+    signature_version++;
+}
+
+// Same rows in the same order: timestamps are unique, so the newest limit are too
+static bool same_rows(const std::vector<LogInfo> &a, const std::vector<LogInfo> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].timestamp != b[i].timestamp || a[i].src_ip != b[i].src_ip || a[i].dest_ip != b[i].dest_ip
+            || a[i].country != b[i].country || a[i].signature != b[i].signature || a[i].tags != b[i].tags) return false;
+    }
+    return true;
+}
+
+static void test_parser() {
+    // Errors point at the token that did not parse
+    const std::pair<const char*, const char*> errors[] = {
+        {"src_ip =", "expected a value at the end"},
+        {"bogus = 1", "unknown field at 'bogus'"},
+        {"severity < high", "expected a number at 'high'"},
+        {"src_ip < 10.0.0.1", "expected =, !=, in or contains at '<'"},
+        {"severity contains 2", "contains needs a text field at 'contains'"},
+        {"time in (1, 2)", "in needs a field other than time at 'in'"},
+        {"(country = france", "expected ) at the end"},
+        {"country = france germany", "expected and, or or the end at 'germany'"},
+        {"time > yesterday", "expected a time (now-1h, epoch seconds or 2026-10-19T09:00:00) at 'yesterday'"},
+        {"sig = \"scan", "unterminated string at 7"},
+    };
+    for (const auto &[text, message] : errors) {
+        std::string error;
+        CHECK(compile_query(text, error) == nullptr);
+        if (error != message) std::cerr << text << ": got \"" << error << "\", expected \"" << message << "\"" << std::endl;
+        CHECK(error == message);
+    }
+
+    // or binds weakest, then and, then not
+    std::string error;
+    auto query = compile_query("country = france or sig contains scan and src_ip in 10.0.0.0/8", error);
+    CHECK(query && query->root.kind == QueryNode::OR && query->root.children.size() == 2);
+    CHECK(query && query->root.children[1].kind == QueryNode::AND);
+    query = compile_query("not country = france and severity <= 2", error);
+    CHECK(query && query->root.kind == QueryNode::AND && query->root.children[0].kind == QueryNode::NOT);
+    query = compile_query("(country = france or country = germany) and sig contains scan", error);
+    CHECK(query && query->root.kind == QueryNode::AND && query->root.children[0].kind == QueryNode::OR);
+    query = compile_query("country = a and country = b and country = c or country = d", error);
+    CHECK(query && query->root.kind == QueryNode::OR && query->root.children[0].children.size() == 3);
+
+    LogInfo info;
+    info.timestamp = BASE_TIME;
+    info.src_ip = "10.1.2.3";
+    info.dest_ip = "192.168.1.7";
+    info.country = "Germany";
+    info.signature = "ET SCAN Nmap";
+    info.tags = "dmz, vpn";
+    fill_log_text(info);
+    const std::pair<const char*, bool> matches[] = {
+        {"country = france or sig contains scan and src_ip in 10.0.0.0/8", true},
+        {"(country = france or sig contains scan) and src_ip in 192.168.0.0/16", false},
+        {"not country = germany or tags contains vpn", true},
+        {"not (country = germany or tags contains vpn)", false},
+        {"country = \"GERMANY\" and tags = dmz", true},
+        {"dest_ip in (1.1.1.1, 192.168.1.0/24) and time >= 1792000800", true},
+    };
+    for (const auto &[text, expected] : matches) {
+        query = compile_query(text, error);
+        CHECK(query != nullptr);
+        if (query && query_matches(*query, info) != expected) std::cerr << text << ": expected " << expected << std::endl;
+        CHECK(query && query_matches(*query, info) == expected);
+    }
+
+    // Only time comparisons under the root and bound the matches
+    query = compile_query("time >= 100 and sig contains scan and time < 200", error);
+    CHECK(query && query->from == 100 && query->to == 200);
+    query = compile_query("time >= 100 or time < 50", error);
+    CHECK(query && query->from == 0 && query->to == 1e18);
+
+    CHECK(looks_like_query("severity <= 2"));
+    CHECK(looks_like_query("sig contains scan"));
+    CHECK(!looks_like_query("masscan"));
+    CHECK(!looks_like_query("scan,-et"));
+}
+
+static void test_segments() {
+    std::string dir = temp_dir("segments");
+    add_signature_info();
+    auto owner = std::make_shared<SegmentStore>(dir, true);   // The writer thread holds a reference
+    SegmentStore &store = *owner;
+    uint32_t state = 1;
+    std::vector<LogInfo> rows;
+    for (int i = 0; i < 30000; i++) rows.push_back(make_row(BASE_TIME + i * 3, state));
+    for (const auto &row : rows) store.append(row);
+    store.flush();
+    // Newer rows left buffered, so the searches also cover rows not written yet
+    for (int i = 0; i < 500; i++) {
+        rows.push_back(make_row(BASE_TIME + 30000 * 3 + i, state));
+        store.append(rows.back());
+    }
+    std::vector<std::shared_ptr<const Segment>> segments;
+    std::vector<LogInfo> pending;
+    store.snapshot(segments, pending);
+    CHECK(segments.size() > 1);
+    CHECK(!pending.empty());
+
+    const char* queries[] = {
+        "src_ip in 10.0.0.0/8",
+        "severity <= 1 and country != \"Unknown\"",
+        "sig contains scan or tags contains dmz",
+        "not (country = germany) and time > 1792040000",
+        "dest_ip = 192.168.1.7",
+        "category = \"Attempted Recon\" and time >= 1792020000 and time < 1792030000",
+        "src_ip in (10.0.0.1, 2001:db8::1, 172.16.0.0/12) and not tags = vpn",
+        "country = nowhere",
+    };
+    for (const char* text : queries) {
+        std::string error;
+        auto query = compile_query(text, error);
+        CHECK(query != nullptr);
+        if (!query) continue;
+        std::vector<LogInfo> all;
+        for (const auto &row : rows) if (query_matches(*query, row)) all.push_back(row);
+        for (size_t limit : {1, 50, 5000, 100000}) {
+            std::vector<LogInfo> expected = all;
+            keep_newest(expected, limit);
+            bool same = same_rows(run_query(*query, store, limit), expected);
+            if (!same) std::cerr << text << ", limit " << limit << ": differs from query_matches" << std::endl;
+            CHECK(same);
+        }
+    }
+
+    // The substring filter, with and without a time window
+    const char* filters[] = {"10.0.", "scan", "-unknown", "dmz,-germany", "src=8.8.8.8", "-tag=vpn"};
+    for (const char* text : filters) {
+        SearchTerms terms = parse_search_terms(text);
+        for (auto [from, to] : {std::make_pair(0.0, DBL_MAX), std::make_pair(BASE_TIME + 20000, BASE_TIME + 60000)}) {
+            std::vector<LogInfo> expected;
+            for (const auto &row : rows) {
+                if (row.timestamp >= from && row.timestamp <= to && pass_search(terms, row)) expected.push_back(row);
+            }
+            keep_newest(expected, 2000);
+            bool same = same_rows(store.query(terms, from, to, 2000), expected);
+            if (!same) std::cerr << text << " in [" << from << ", " << to << "]: differs from pass_search" << std::endl;
+            CHECK(same);
+        }
+    }
+    store.flush();
+}
+
+static void test_checkpoint() {
+    std::string dir = temp_dir("checkpoint");
+    std::string input = dir + "/eve.json";
+    std::string checkpoint = dir + "/checkpoint.bin";
+    {
+        std::ofstream file(input);
+        for (int i = 0; i < 1000; i++) file << "{\"event_type\":\"stats\"}\n";
+    }
+
+    segment_store = std::make_shared<SegmentStore>(dir + "/store", true);
+    uint32_t state = 7;
+    for (int i = 0; i < 20000; i++) aggregate_event(make_alert(i * 4, state));
+    checkpoint_enable(checkpoint, input, 60);
+    CHECK(write_checkpoint(12345));
+
+    // Saved state: the aggregates, then every row the store holds
+    long long saved_sum = sum;
+    auto saved_totals = std::make_tuple(src_ip_total, dest_ip_total, country_total, signature_total, tag_total);
+    auto saved_times = std::make_pair(attacks_per_hour, attacks_per_minute);
+    std::map<double, BarDetail> saved_bars = all_bar_hour;
+    std::map<std::string, SignatureInfo> saved_info = signature_info;
+    std::deque<LogInfo> saved_logs = all_logs;
+    SearchTerms everything = parse_search_terms("");
+    std::vector<LogInfo> saved_rows = segment_store->query(everything, 0, DBL_MAX, 100000);
+    CHECK(saved_rows.size() == 20000);
+
+    // Alerts aggregated after the checkpoint are read again, so the warm start drops them
+    for (int i = 20000; i < 20100; i++) aggregate_event(make_alert(i * 4, state));
+    segment_store->flush();
+    segment_store = std::make_shared<SegmentStore>(dir + "/store", true);
+    clear_aggregates();
+    CHECK(load_checkpoint(checkpoint, input));
+    CHECK(checkpoint_start_offset() == 12345);
+
+    CHECK(sum == saved_sum);
+    CHECK(std::make_tuple(src_ip_total, dest_ip_total, country_total, signature_total, tag_total) == saved_totals);
+    CHECK(std::make_pair(attacks_per_hour, attacks_per_minute) == saved_times);
+    bool same_bars = all_bar_hour.size() == saved_bars.size();
+    for (auto a = all_bar_hour.begin(), b = saved_bars.begin(); same_bars && a != all_bar_hour.end(); ++a, ++b) {
+        same_bars = a->first == b->first && a->second.src_count == b->second.src_count && a->second.dest_count == b->second.dest_count
+            && a->second.signature_count == b->second.signature_count && a->second.country_count == b->second.country_count
+            && a->second.tag_count == b->second.tag_count;
+    }
+    CHECK(same_bars);
+    bool same_info = signature_info.size() == saved_info.size();
+    for (auto a = signature_info.begin(), b = saved_info.begin(); same_info && a != signature_info.end(); ++a, ++b) {
+        same_info = a->first == b->first && a->second.category == b->second.category && a->second.severity == b->second.severity
+            && a->second.last_seen == b->second.last_seen;
+    }
+    CHECK(same_info);
+    CHECK(same_rows(std::vector<LogInfo>(all_logs.begin(), all_logs.end()), std::vector<LogInfo>(saved_logs.begin(), saved_logs.end())));
+    CHECK(same_rows(segment_store->query(everything, 0, DBL_MAX, 100000), saved_rows));
+
+    // A flipped byte fails the checksum and leaves the aggregates empty
+    {
+        std::fstream file(checkpoint, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(100);
+        char byte = (char)file.get();
+        file.seekp(100);
+        file.put((char)(byte ^ 1));
+    }
+    clear_aggregates();
+    CHECK(!load_checkpoint(checkpoint, input));
+    CHECK(sum == 0 && src_ip_total.empty() && all_logs.empty());
+    segment_store->flush();
+}
+
+int main(int argc, char** argv) {
+    std::string group = argc > 1 ? argv[1] : "";
+    if (group == "parser") test_parser();
+    else if (group == "segments") test_segments();
+    else if (group == "checkpoint") test_checkpoint();
+    else {
+        std::cerr << "Usage: " << argv[0] << " parser|segments|checkpoint" << std::endl;
+        return 2;
+    }
+    if (failures) std::cerr << failures << " check(s) failed" << std::endl;
+    return failures ? 1 : 0;
+}
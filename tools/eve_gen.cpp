@@ -0,0 +1,384 @@
+// Synthetic eve.json generator for load tests.
+//
+// Bulk mode (no --eps) writes --events lines or --size bytes as fast as possible,
+// with timestamps spaced at --sim-eps. Live mode (--eps R) appends R lines per
+// second stamped with the current time, for tail benchmarks.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+
+enum EventType { EV_ALERT, EV_FLOW, EV_DNS, EV_HTTP, EV_TLS, EV_COUNT };
+static const char* EVENT_NAMES[EV_COUNT] = {"alert", "flow", "dns", "http", "tls"};
+
+struct GenOptions {
+    std::string output;
+    bool append = false;
+    long long events = 0;       // 0 = no limit
+    long long size = 0;         // bytes, 0 = no limit
+    double eps = 0;             // live rate, 0 = bulk mode
+    double sim_eps = 100;       // timestamp spacing in bulk mode
+    double burst = 1;           // rate multiplier during a burst second
+    double burst_prob = 0.1;    // chance that a second is a burst
+    double weights[EV_COUNT] = {40, 25, 15, 10, 10};
+    int hosts = 10000;
+    int signatures = 500;
+    double zipf = 1.1;
+    double ipv6 = 0.1;
+    double long_ratio = 0.01;   // share of http/tls records padded past long_size
+    int long_size = 8192;
+    unsigned seed = 1;
+    long long start = 0;        // first timestamp in bulk mode, 0 = now - duration
+};
+
+// Samples ranks 0..n-1 with P(k) ~ 1 / (k + 1)^s
+class Zipf {
+    private:
+        std::vector<double> cdf;
+
+    public:
+        Zipf(int n, double s) : cdf(n) {
+            double total = 0;
+            for (int k = 0; k < n; k++) cdf[k] = total += 1.0 / std::pow(k + 1.0, s);
+            for (double &c : cdf) c /= total;
+        }
+
+        int operator()(std::mt19937_64 &rng) const {
+            double u = std::uniform_real_distribution<double>(0, 1)(rng);
+            return (int)(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+        }
+};
+
+static long long parse_size(const char* text) {
+    char* end = nullptr;
+    double value = strtod(text, &end);
+    switch (*end) {
+        case 'k': case 'K': value *= 1e3; break;
+        case 'm': case 'M': value *= 1e6; break;
+        case 'g': case 'G': value *= 1e9; break;
+    }
+    return (long long)value;
+}
+
+static bool parse_mix(const std::string &text, double* weights) {
+    std::fill(weights, weights + EV_COUNT, 0.0);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t comma = text.find(',', pos);
+        std::string item = text.substr(pos, comma - pos);
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string name = item.substr(0, eq);
+        int type = -1;
+        for (int i = 0; i < EV_COUNT; i++) if (name == EVENT_NAMES[i]) type = i;
+        if (type == -1) return false;
+        weights[type] = atof(item.c_str() + eq + 1);
+        if (comma == std::string::npos) break;
+        pos = comma + 1;
+    }
+    return true;
+}
+
+static void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " --output FILE [options]\n"
+              << "  --append          append instead of truncating\n"
+              << "  --events N        stop after N lines\n"
+              << "  --size BYTES      stop after BYTES (suffix K, M, G)\n"
+              << "  --eps R           live mode: R lines per second stamped with the current time\n"
+              << "  --sim-eps R       bulk mode: timestamp spacing in lines per second (default 100)\n"
+              << "  --start EPOCH     bulk mode: first timestamp (default so the last one is now)\n"
+              << "  --burst F         multiply the rate by F during burst seconds (default 1)\n"
+              << "  --burst-prob P    chance that a second is a burst (default 0.1)\n"
+              << "  --mix LIST        event weights, e.g. alert=40,flow=25,dns=15,http=10,tls=10\n"
+              << "  --hosts N         distinct addresses per side (default 10000)\n"
+              << "  --signatures N    distinct signatures (default 500)\n"
+              << "  --zipf S          skew of address and signature popularity (default 1.1)\n"
+              << "  --ipv6 R          share of IPv6 addresses (default 0.1)\n"
+              << "  --long-ratio R    share of http/tls lines padded past --long-size (default 0.01)\n"
+              << "  --long-size N     bytes of a long line (default 8192)\n"
+              << "  --seed N          random seed (default 1)\n";
+}
+
+static bool parse_options(int argc, char** argv, GenOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--append") options.append = true;
+        else if (arg == "--events" && has_value) options.events = atoll(argv[++i]);
+        else if (arg == "--size" && has_value) options.size = parse_size(argv[++i]);
+        else if (arg == "--eps" && has_value) options.eps = atof(argv[++i]);
+        else if (arg == "--sim-eps" && has_value) options.sim_eps = std::max(0.001, atof(argv[++i]));
+        else if (arg == "--start" && has_value) options.start = atoll(argv[++i]);
+        else if (arg == "--burst" && has_value) options.burst = std::max(1.0, atof(argv[++i]));
+        else if (arg == "--burst-prob" && has_value) options.burst_prob = atof(argv[++i]);
+        else if (arg == "--mix" && has_value) {
+            if (!parse_mix(argv[++i], options.weights)) {
+                std::cerr << "ERROR: bad --mix " << argv[i] << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--hosts" && has_value) options.hosts = std::max(1, atoi(argv[++i]));
+        else if (arg == "--signatures" && has_value) options.signatures = std::max(1, atoi(argv[++i]));
+        else if (arg == "--zipf" && has_value) options.zipf = atof(argv[++i]);
+        else if (arg == "--ipv6" && has_value) options.ipv6 = atof(argv[++i]);
+        else if (arg == "--long-ratio" && has_value) options.long_ratio = atof(argv[++i]);
+        else if (arg == "--long-size" && has_value) options.long_size = std::max(0, atoi(argv[++i]));
+        else if (arg == "--seed" && has_value) options.seed = (unsigned)atoi(argv[++i]);
+        else {
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.output.empty()) {
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options.eps <= 0 && options.events <= 0 && options.size <= 0) {
+        std::cerr << "ERROR: bulk mode needs --events or --size" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Address pools: index 0 is the most popular host
+static std::vector<std::string> make_hosts(int n, double ipv6, bool internal, std::mt19937_64 &rng) {
+    std::vector<std::string> hosts(n);
+    std::uniform_real_distribution<double> coin(0, 1);
+    char buf[64];
+    for (int i = 0; i < n; i++) {
+        if (coin(rng) < ipv6) {
+            snprintf(buf, sizeof(buf), "2001:db8:%x:%x::%x", internal ? 0 : (unsigned)(rng() & 0xffff),
+                     (unsigned)(i >> 16), (unsigned)(i & 0xffff) + 1);
+        }
+        else if (internal) {
+            snprintf(buf, sizeof(buf), "10.%u.%u.%u", (unsigned)((i + 1) >> 16) & 0xff, (unsigned)((i + 1) >> 8) & 0xff, (unsigned)(i + 1) & 0xff);
+        }
+        else {
+            uint32_t a = (uint32_t)rng();
+            snprintf(buf, sizeof(buf), "%u.%u.%u.%u", 1 + (a >> 24) % 223, (a >> 16) & 0xff, (a >> 8) & 0xff, 1 + a % 254);
+        }
+        hosts[i] = buf;
+    }
+    return hosts;
+}
+
+struct Signature {
+    int id;
+    std::string name;
+    const char* category;
+    int severity;
+};
+
+static std::vector<Signature> make_signatures(int n) {
+    static const char* prefixes[] = {
+        "ET SCAN", "ET POLICY", "ET TROJAN", "ET WEB_SERVER", "ET EXPLOIT",
+        "ET DNS", "ET MALWARE", "ET INFO", "GPL ATTACK_RESPONSE", "ET CURRENT_EVENTS"
+    };
+    static const char* subjects[] = {
+        "Masscan detected", "Dropbox Client Broadcasting", "Suspicious User-Agent", "SQL Injection Attempt",
+        "Possible CVE Exploit", "Query to Known Bad Domain", "Outbound Beacon", "Executable Download",
+        "id check returned root", "Phishing Landing Page"
+    };
+    static const char* categories[] = {
+        "Detection of a Network Scan", "Potential Corporate Privacy Violation", "A Network Trojan was Detected",
+        "Web Application Attack", "Attempted Administrator Privilege Gain", "Potentially Bad Traffic",
+        "Misc activity", "Not Suspicious Traffic"
+    };
+    std::vector<Signature> signatures(n);
+    for (int i = 0; i < n; i++) {
+        char name[160];
+        snprintf(name, sizeof(name), "%s %s %d", prefixes[i % 10], subjects[(i / 10) % 10], i);
+        signatures[i] = {2000000 + i, name, categories[i % 8], 1 + i % 3};
+    }
+    return signatures;
+}
+
+static void format_timestamp(char* buf, size_t size, double time) {
+    std::time_t t = (std::time_t)time;
+    std::tm tm = {};
+    #ifdef _WIN32
+        gmtime_s(&tm, &t);
+    #else
+        gmtime_r(&t, &tm);
+    #endif
+    size_t len = strftime(buf, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + len, size - len, ".%06d+0000", (int)((time - (double)t) * 1e6));
+}
+
+class Generator {
+    private:
+        const GenOptions &options;
+        std::mt19937_64 rng;
+        std::vector<std::string> internal_hosts, external_hosts;
+        std::vector<Signature> signatures;
+        Zipf host_rank, signature_rank;
+        std::discrete_distribution<int> event_type;
+        std::string filler;
+        unsigned long long flow_id = 1000000;
+
+        const std::string &pick(const std::vector<std::string> &hosts) { return hosts[host_rank(rng)]; }
+        bool coin(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+        int port() { return 1024 + (int)(rng() % 64000); }
+
+        // Padding that pushes a record past long_size, or nothing
+        const char* padding(size_t line_estimate) {
+            if (!coin(options.long_ratio) || (size_t)options.long_size <= line_estimate) return "";
+            return filler.c_str() + filler.size() - (options.long_size - line_estimate);
+        }
+
+    public:
+        explicit Generator(const GenOptions &options)
+            : options(options), rng(options.seed),
+              host_rank(options.hosts, options.zipf), signature_rank(options.signatures, options.zipf),
+              event_type(options.weights, options.weights + EV_COUNT),
+              filler(std::max(options.long_size, 0), 'A') {
+            internal_hosts = make_hosts(options.hosts, options.ipv6, true, rng);
+            external_hosts = make_hosts(options.hosts, options.ipv6, false, rng);
+            signatures = make_signatures(options.signatures);
+        }
+
+        // Writes one line, returns its length in bytes
+        int write(FILE* out, double time) {
+            char ts[48];
+            format_timestamp(ts, sizeof(ts), time);
+            bool inbound = coin(0.5);
+            const std::string &src = inbound ? pick(external_hosts) : pick(internal_hosts);
+            const std::string &dest = inbound ? pick(internal_hosts) : pick(external_hosts);
+            int sport = port(), dport = coin(0.7) ? 443 : port();
+            flow_id++;
+
+            switch (event_type(rng)) {
+                case EV_ALERT: {
+                    const Signature &sig = signatures[signature_rank(rng)];
+                    return fprintf(out,
+                        "{\"timestamp\":\"%s\",\"flow_id\":%llu,\"event_type\":\"alert\",\"src_ip\":\"%s\",\"src_port\":%d,"
+                        "\"dest_ip\":\"%s\",\"dest_port\":%d,\"proto\":\"TCP\",\"alert\":{\"action\":\"allowed\",\"gid\":1,"
+                        "\"signature_id\":%d,\"rev\":1,\"signature\":\"%s\",\"category\":\"%s\",\"severity\":%d},"
+                        "\"app_proto\":\"http\",\"http\":{\"hostname\":\"host%d.example.com\",\"url\":\"/%s\",\"http_method\":\"GET\",\"status\":200},"
+                        "\"flow\":{\"pkts_toserver\":%d,\"pkts_toclient\":%d,\"bytes_toserver\":%d,\"bytes_toclient\":%d,\"start\":\"%s\"}}\n",
+                        ts, flow_id, src.c_str(), sport, dest.c_str(), dport,
+                        sig.id, sig.name.c_str(), sig.category, sig.severity,
+                        (int)(rng() % 1000), padding(600),
+                        1 + (int)(rng() % 50), (int)(rng() % 50), 60 + (int)(rng() % 100000), (int)(rng() % 100000), ts);
+                }
+                case EV_FLOW:
+                    return fprintf(out,
+                        "{\"timestamp\":\"%s\",\"flow_id\":%llu,\"event_type\":\"flow\",\"src_ip\":\"%s\",\"src_port\":%d,"
+                        "\"dest_ip\":\"%s\",\"dest_port\":%d,\"proto\":\"TCP\",\"app_proto\":\"tls\","
+                        "\"flow\":{\"pkts_toserver\":%d,\"pkts_toclient\":%d,\"bytes_toserver\":%d,\"bytes_toclient\":%d,"
+                        "\"start\":\"%s\",\"end\":\"%s\",\"age\":%d,\"state\":\"closed\",\"reason\":\"timeout\"}}\n",
+                        ts, flow_id, src.c_str(), sport, dest.c_str(), dport,
+                        1 + (int)(rng() % 500), (int)(rng() % 500), 60 + (int)(rng() % 1000000), (int)(rng() % 1000000),
+                        ts, ts, (int)(rng() % 120));
+                case EV_DNS:
+                    return fprintf(out,
+                        "{\"timestamp\":\"%s\",\"flow_id\":%llu,\"event_type\":\"dns\",\"src_ip\":\"%s\",\"src_port\":%d,"
+                        "\"dest_ip\":\"%s\",\"dest_port\":53,\"proto\":\"UDP\",\"dns\":{\"type\":\"query\",\"id\":%d,"
+                        "\"rrname\":\"host%d.example.com\",\"rrtype\":\"%s\",\"tx_id\":0}}\n",
+                        ts, flow_id, src.c_str(), sport, dest.c_str(),
+                        (int)(rng() % 65536), host_rank(rng), coin(0.8) ? "A" : "AAAA");
+                case EV_HTTP:
+                    return fprintf(out,
+                        "{\"timestamp\":\"%s\",\"flow_id\":%llu,\"event_type\":\"http\",\"src_ip\":\"%s\",\"src_port\":%d,"
+                        "\"dest_ip\":\"%s\",\"dest_port\":80,\"proto\":\"TCP\",\"tx_id\":0,\"http\":{\"hostname\":\"host%d.example.com\","
+                        "\"url\":\"/index.php?id=%d&q=%s\",\"http_user_agent\":\"Mozilla/5.0 (X11; Linux x86_64) Generator/%d\","
+                        "\"http_content_type\":\"text/html\",\"http_method\":\"%s\",\"protocol\":\"HTTP/1.1\",\"status\":%d,\"length\":%d}}\n",
+                        ts, flow_id, src.c_str(), sport, dest.c_str(),
+                        host_rank(rng), (int)(rng() % 100000), padding(400), (int)(rng() % 100),
+                        coin(0.8) ? "GET" : "POST", coin(0.9) ? 200 : 404, (int)(rng() % 100000));
+                default:
+                    return fprintf(out,
+                        "{\"timestamp\":\"%s\",\"flow_id\":%llu,\"event_type\":\"tls\",\"src_ip\":\"%s\",\"src_port\":%d,"
+                        "\"dest_ip\":\"%s\",\"dest_port\":443,\"proto\":\"TCP\",\"tls\":{\"subject\":\"CN=host%d.example.com\","
+                        "\"issuerdn\":\"C=US, O=Example CA, CN=Example Issuing CA %d\",\"serial\":\"%llX\",\"fingerprint\":\"%016llx\","
+                        "\"sni\":\"host%d.example.com\",\"version\":\"TLS 1.2\",\"certificate\":\"MII%s\"}}\n",
+                        ts, flow_id, src.c_str(), sport, dest.c_str(),
+                        host_rank(rng), (int)(rng() % 10), (unsigned long long)rng(), (unsigned long long)rng(),
+                        host_rank(rng), padding(400));
+            }
+        }
+
+        // Rate multiplier for the next second
+        double next_second_rate() { return coin(options.burst_prob) ? options.burst : 1.0; }
+};
+
+static bool done(const GenOptions &options, long long events, long long bytes) {
+    return (options.events > 0 && events >= options.events) || (options.size > 0 && bytes >= options.size);
+}
+
+int main(int argc, char** argv) {
+    GenOptions options;
+    if (!parse_options(argc, argv, options)) return -1;
+
+    FILE* out = fopen(options.output.c_str(), options.append ? "ab" : "wb");
+    if (!out) {
+        std::cerr << "ERROR: cannot open " << options.output << std::endl;
+        return -1;
+    }
+    setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    Generator generator(options);
+    long long events = 0, bytes = 0;
+    auto wall_start = std::chrono::steady_clock::now();
+
+    if (options.eps <= 0) {
+        // Bulk: timestamps advance at sim_eps, bursts compress the spacing
+        double time = (double)options.start;
+        if (options.start == 0) {
+            long long expected = options.events > 0 ? options.events : options.size / 400;
+            time = (double)std::time(0) - expected / options.sim_eps;
+        }
+        double step = 1.0 / options.sim_eps;
+        double second_end = time + 1;
+        double rate = generator.next_second_rate();
+        while (!done(options, events, bytes)) {
+            bytes += generator.write(out, time);
+            events++;
+            time += step / rate;
+            if (time >= second_end) {
+                second_end += 1;
+                rate = generator.next_second_rate();
+            }
+        }
+    }
+    else {
+        // Live: 10 ms ticks, each writes its share of the current second's rate
+        const auto tick = std::chrono::milliseconds(10);
+        auto next = std::chrono::steady_clock::now();
+        double rate = options.eps * generator.next_second_rate();
+        double owed = 0;
+        int ticks = 0;
+        while (!done(options, events, bytes)) {
+            owed += rate / 100;
+            auto now_wall = std::chrono::system_clock::now();
+            double now = std::chrono::duration<double>(now_wall.time_since_epoch()).count();
+            for (; owed >= 1 && !done(options, events, bytes); owed -= 1) {
+                bytes += generator.write(out, now);
+                events++;
+            }
+            fflush(out);
+
+            if (++ticks == 100) {
+                ticks = 0;
+                rate = options.eps * generator.next_second_rate();
+            }
+            next += tick;
+            std::this_thread::sleep_until(next);
+        }
+    }
+    fclose(out);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    std::cerr << "Wrote " << events << " lines, " << bytes << " bytes in " << seconds << " s ("
+              << events / std::max(seconds, 1e-9) << " lines/s)" << std::endl;
+    return 0;
+}